@@ -40,18 +40,37 @@
 /*     program constitutes acceptance of these licensing restrictions.   */
 /*  5. Absolutely no warranty is expressed or implied.                   */
 /*-----------------------------------------------------------------------*/
+#define _GNU_SOURCE	/* sched_setaffinity(), CPU_SET() */
 # include <stdio.h>
 # include <unistd.h>
 # include <math.h>
 # include <float.h>
 # include <limits.h>
 # include <sys/time.h>
+# include <time.h>
+# include <signal.h>
+# include <setjmp.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <errno.h>
 
 //swsok, definition of uintptr_t
 #include <stdint.h>
@@ -95,7 +114,7 @@
  *      Array size can be set at compile time without modifying the source
  *          code for the (many) compilers that support preprocessor definitions
  *          on the compile line.  E.g.,
- *                gcc -O -DSTREAM_ARRAY_SIZE=100000000 stream.c -o stream.100M
+ *                gcc -O -DSTREAM_ARRAY_SIZE=100000000 stream.c -o stream.100M -lm
  *          will override the default size of 10M with a new size of 100M elements
  *          per array.
  */
@@ -111,6 +130,8 @@
  *         increase the reported performance.
  *      NTIMES can also be set on the compile line without changing the source
  *         code using, for example, "-DNTIMES=7".
+ *      At run time "--ntimes=N" overrides NTIMES, and "--warmup=W" sets how many
+ *         leading iterations (default 1) are excluded from the statistics.
  */
 #ifdef NTIMES
 #if NTIMES<=1
@@ -140,12 +161,12 @@
  *       optimizer might be too smart for me!
  *
  *     For a simple single-core version, try compiling with:
- *            cc -O stream.c -o stream
+ *            cc -O stream.c -o stream -lm
  *     This is known to work on many, many systems....
  *
  *     To use multiple cores, you need to tell the compiler to obey the OpenMP
  *       directives in the code.  This varies by compiler, but a common example is
- *            gcc -O -fopenmp stream.c -o stream_omp
+ *            gcc -O -fopenmp stream.c -o stream_omp -lm
  *       The environment variable OMP_NUM_THREADS allows runtime control of the 
  *         number of threads/cores used when the resulting "stream_omp" program
  *         is executed.
@@ -159,6 +180,9 @@
  *       code to call separate functions to execute each kernel.  Trivial versions
  *       of these functions are provided, but they are *not* tuned -- they just 
  *       provide predefined interfaces to be replaced with tuned code.
+ *     When compiled for RISC-V with the V extension (e.g. -march=rv64gcv, see
+ *       "make stream_rvv.exe"), the tuned kernels use vector loads/stores.
+ *       Such a binary is for V-capable cores only.
  *
  *
  *	4) Optional: Mail the results to mccalpin@cs.virginia.edu
@@ -198,29 +222,83 @@ static STREAM_TYPE      *a = NULL,
 			*b = NULL,
 			*c = NULL;
 
-static double	avgtime[4] = {0}, maxtime[4] = {0},
-		mintime[4] = {FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX};
+/*
+ * The kernel registry.  kernel_table[] (defined after the kernel bodies,
+ * before run_kernels()) describes each kernel by name, the bytes it moves
+ * over n elements, its body and what it does to the expected a/b/c values
+ * checkSTREAMresults() tracks.  The first STREAM_KERNELS entries are the
+ * four STREAM kernels, followed by the read-only, write-only and
+ * read:write mix kernels.  kernel_sel[] is the order the main timed loop
+ * runs them in (--kernels, or all of them with --rw); kernel_ran[] holds
+ * the kernels_run kernels the last timed loop executed, and the summary,
+ * the reports and checkSTREAMresults() follow it.
+ */
+#define STREAM_KERNELS	4
+#define NKERNELS	7
+struct stream_model {
+	STREAM_TYPE	a, b, c;		/* value of every element */
+	double		read_sum, mix_sum;	/* what Read and Mix should add up */
+};
+struct stream_kernel {
+	const char	*name, *label;
+	double		(*nbytes)(ssize_t n);
+	void		(*body)(ssize_t stream_array_size, STREAM_TYPE scalar);
+	void		(*model)(struct stream_model *m, STREAM_TYPE scalar, ssize_t n);
+};
+static const struct stream_kernel	kernel_table[NKERNELS];
+static const int	stream_order[NKERNELS] = {0, 1, 2, 3, 4, 5, 6};
+static int	kernel_sel[NKERNELS] = {0, 1, 2, 3, 4, 5, 6}, nkernels = STREAM_KERNELS;
+static int	kernels_given = 0;	/* --kernels seen, --rw leaves the list alone */
+static const int	*kernel_ran = stream_order;
+static int	kernels_run = STREAM_KERNELS;
+
+static double	avgtime[NKERNELS] = {0}, maxtime[NKERNELS] = {0},
+		mintime[NKERNELS] = {FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX,FLT_MAX};
+
+/* distribution of the per-iteration times, see sample_stats() */
+struct time_stats {
+	double	avg, min, max, stddev;
+	double	pct[4];		/* at pct_level[] */
+	int	n;		/* samples counted, 0 = no statistics (all NAN) */
+};
+static const double	pct_level[4] = {50.0, 90.0, 99.0, 99.9};
+static struct time_stats	timestats[NKERNELS];
 
-static char	*label[4] = {"Copy:      ", "Scale:     ",
-    "Add:       ", "Triad:     "};
+/* iterations per kernel and how many leading ones are excluded */
+static int	ntimes = NTIMES, warmup = 1;
 
-static double	bytes[4] = {
-    2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
-    2 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
-    3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE,
-    3 * sizeof(STREAM_TYPE) * STREAM_ARRAY_SIZE
-    };
+/* kernel_table[j].nbytes() of the full arrays, set in main() */
+static double	bytes[NKERNELS];
+
+/*
+ * Read-only and write-only kernels: Read sums a[] (the sum is kept so the
+ * loads cannot be dropped), Write fills c[] with write_value.  Mix walks
+ * the arrays a cache line at a time and, per group of rw_read + rw_write
+ * lines, sums the first rw_read lines of a[] and fills the remaining
+ * rw_write lines of c[], so the link sees that read:write line ratio.
+ */
+static int		rw_read = 2, rw_write = 1;
+static const STREAM_TYPE	write_value = 0.5;
+static STREAM_TYPE	read_sum, mix_sum;
 
 extern double mysecond();
-extern void checkSTREAMresults(ssize_t stream_array_size);
+extern int timer_init(const char *name);
+extern const char *timer_source(void);
+extern double timer_frequency(void);
+extern int checkSTREAMresults(ssize_t stream_array_size);
 #ifdef TUNED
 extern void tuned_STREAM_Copy(ssize_t stream_array_size);
 extern void tuned_STREAM_Scale(STREAM_TYPE scalar, ssize_t stream_array_size);
 extern void tuned_STREAM_Add(ssize_t stream_array_size);
 extern void tuned_STREAM_Triad(STREAM_TYPE scalar, ssize_t stream_array_size);
+extern int tuned_init(int lmul);
+extern void tuned_describe(void);
 #endif
 #ifdef _OPENMP
 extern int omp_get_num_threads();
+extern int omp_get_thread_num();
+extern int omp_get_max_threads();
+extern void omp_set_num_threads(int);
 #endif
 //#define PRINT
 #ifdef PRINT
@@ -232,66 +310,818 @@ extern int omp_get_num_threads();
 #define PRINT_LOG(x)
 #define PRINT_PROGRESS(name, x)
 #endif
+
+/*
+ * Placement of the a[], b[] and c[] arrays, one letter per array:
+ *	'L' - local RAM (aligned_alloc)
+ *	'R' - remote memory, mmap'ed from the device file at
+ *	      offset + i*buffer_size for array i (a=0, b=1, c=2)
+ * The default is "RRR" when a device is given and "LLL" otherwise.
+ * With --place-sweep both backings are set up for every array and the
+ * kernels are run over all eight combinations.
+ */
+#define PLACE_LOCAL	'L'
+#define PLACE_REMOTE	'R'
+static char		placement[4] = "";
+static int		place_sweep = 0;
+static int		nt_mode = 0;
+static ssize_t		size_sweep_min = 0, size_sweep_max = 0;	/* bytes per array */
+static int		size_sweep_steps = 4;		/* per octave */
+static int		latency_mode = 0, loaded_latency = 0;
+static int		numa_matrix = 0;
+static int		thread_sweep = 0;	/* max threads; -1 = OMP_NUM_THREADS */
+
+/* --pattern list, see run_patterns() */
+#define PAT_SEQ			0
+#define PAT_STRIDE		1
+#define PAT_SHUFFLE		2
+#define PAT_GATHER		3
+#define PAT_SCATTER		4
+struct access_pattern {
+	int	kind;
+	ssize_t	param;		/* stride in elements or block in bytes */
+	char	name[32];
+};
+static struct access_pattern	patterns[16];
+static int		npatterns = 0;
+
+/* --tile, see run_tiles() */
+#define TILE_NONE		0
+#define TILE_BARRIER		1
+#define TILE_FENCE		2
+static int		tile_mode = 0, tile_sync = TILE_NONE;
+
+/* --monitor, see run_monitor() */
+static double		monitor_interval = 0;	/* seconds, 0 = off */
+static long		monitor_count = 0;
+static char		*monitor_out = NULL;
+static int		perf_mode = 0;		/* --perf */
+
+/* --devices regions and --stripe granularity, see stripe_map() */
+struct stripe_region {
+	char	path[256];
+	off_t	offset, used;
+	ssize_t	size;		/* 0 = not checked */
+	int	fid;
+};
+static struct stripe_region	stripe_regions[16];
+static int		nstripe = 0;
+static ssize_t		stripe_bytes = 1 << 20;
+
+/* --map caching mode of the device mappings, see open_device() */
+#define MAPMODE_CACHED		0
+#define MAPMODE_SYNC		1
+#define MAPMODE_WC		2
+#define MAPMODE_IOCTL		3
+static int		map_mode = MAPMODE_CACHED;
+static unsigned long	map_ioctl_req = 0, map_ioctl_arg = 0;
+static int		cache_ops_mode = 0;	/* --cache-ops */
+/* --procs/--rank/--rendezvous coordinated runs, see coord_barrier() */
+#define COORD_MAX		32
+static int		coord_procs = 1, coord_rank = 0, coord_tcp = 0;
+static const char	*coord_rendezvous = "shm";
+/* --types/--unroll/--prefetch-dist element variants, see run_variants() */
+static int		variant_mode = 0, variant_types = 0x1f, variant_unrolls = 1 | 2 | 4 | 8;
+static ssize_t		variant_prefetch = 0;	/* bytes */
+/* --prefetch-sweep distances in bytes, see run_prefetch_sweep() */
+static ssize_t		prefetch_dists[32] = {0, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384};
+static int		nprefetch_dists = 10, prefetch_sweep = 0;
+/* --dma copy back-end, see run_dma() */
+static const char	*dma_mode = NULL;
+static ssize_t		dma_chunk = 1 << 20;
+static int		dma_depths[16] = {1, 2, 4, 8, 16}, ndma_depths = 5;
+/* --trace chunk size in cache lines and output, see trace_kernel() */
+static ssize_t		trace_lines = 0;
+static const char	*trace_path = NULL;
+/* --integrity pattern mask and random seed, see run_integrity() */
+static int		integrity_mode = 0;
+static uint64_t		integrity_seed = 1;
+static int		exit_status = 0;	/* set by checks that fail the run */
+/* --baseline regression gate, see baseline_compare() */
+static const char	*baseline_path = NULL;
+static double		baseline_tolerance = 5.0, baseline_alpha = 0.05;	/* percent, p-value */
+
+/* --numa policies for the local arrays */
+#define NUMA_NONE		0
+#define NUMA_FIRSTTOUCH		1
+#define NUMA_BIND		2
+#define NUMA_INTERLEAVE		3
+static int		numa_policy = NUMA_NONE;
+
+/* --hugepages backing of the arrays, see alloc_local() */
+#define HUGE_NONE		0
+#define HUGE_THP		1
+#define HUGE_2M			2
+#define HUGE_1G			3
+static int		hugepage_mode = HUGE_NONE;
+static size_t		page_size = 4096;	/* rounding/alignment of arrays and offset */
+/* how each array's memory was obtained, so teardown undoes exactly that */
+#define REGION_NONE		0
+#define REGION_HEAP		1	/* aligned_alloc() */
+#define REGION_ANON		2	/* MAP_HUGETLB mmap() */
+#define REGION_MAPPED		3	/* map_remote() or stripe_map() window */
+struct mem_region {
+	int		kind, locked;
+	size_t		len;
+};
+static struct mem_region	local_region[3], remote_region[3];
+/* --prefault and --mlock of the arrays, see region_prefault() */
+#define PREFAULT_NONE		0
+#define PREFAULT_POPULATE	1
+#define PREFAULT_WILLNEED	2
+#define PREFAULT_TOUCH		3
+static int		prefault_mode = PREFAULT_NONE, mlock_arrays = 0;
+static double		prefault_seconds = 0;
+/* --validate sampling and --error-map regions, see checkSTREAMresults() */
+#define VALIDATE_FULL		0
+#define VALIDATE_EVERY		1
+#define VALIDATE_RANDOM		2
+static int		validate_mode = VALIDATE_FULL;
+static ssize_t		validate_param = 1, error_map_bytes = 0;
+static off_t		remote_offset = 0;	/* device offset of remote_array[0] */
+static ssize_t		remote_bytes = 0;	/* and the stride to the next one */
+/* --init strategy, see init_arrays() */
+#define INIT_FILL		0
+#define INIT_PAGE		1
+#define INIT_ZERO		2
+#define INIT_REUSE		3
+static int		init_mode = INIT_FILL;
+static STREAM_TYPE	init_a = 1.0, init_b = 2.0, init_c = 0.0;
+static ssize_t		lat_stride = 64, lat_page = 0;	/* bytes */
+static long		lat_loads = 1 << 20;
+static STREAM_TYPE	*local_array[3] = {NULL, NULL, NULL},
+			*remote_array[3] = {NULL, NULL, NULL};
+
+static struct option	long_options[] = {
+    {"place",		required_argument,	NULL, 'p'},
+    {"place-sweep",	no_argument,		NULL, 'P'},
+    {"timer",		required_argument,	NULL, 'T'},
+    {"lmul",		required_argument,	NULL, 'L'},
+    {"nt",		no_argument,		NULL, 'N'},
+    {"size-sweep",	required_argument,	NULL, 'S'},
+    {"pattern",		required_argument,	NULL, 'A'},
+    {"tile",		optional_argument,	NULL, 'i'},
+    {"tile-sync",	required_argument,	NULL, 'y'},
+    {"latency",		no_argument,		NULL, 'l'},
+    {"loaded-latency",	optional_argument,	NULL, 'D'},
+    {"lat-stride",	required_argument,	NULL, 's'},
+    {"lat-page",	required_argument,	NULL, 'g'},
+    {"lat-loads",	required_argument,	NULL, 'd'},
+    {"hugepages",	required_argument,	NULL, 'H'},
+    {"prefault",	required_argument,	NULL, 'B'},
+    {"trace",		required_argument,	NULL, 'q'},
+    {"integrity",	optional_argument,	NULL, 'x'},
+    {"baseline",	required_argument,	NULL, '0'},
+    {"tolerance",	required_argument,	NULL, '1'},
+    {"trace-file",	required_argument,	NULL, 'v'},
+    {"mlock",		no_argument,		NULL, 'Z'},
+    {"thread-sweep",	optional_argument,	NULL, 't'},
+    {"numa",		required_argument,	NULL, 'u'},
+    {"numa-matrix",	no_argument,		NULL, 'U'},
+    {"kernels",		required_argument,	NULL, 'e'},
+    {"types",		required_argument,	NULL, 'Y'},
+    {"unroll",		required_argument,	NULL, 'W'},
+    {"prefetch-dist",	required_argument,	NULL, 'Q'},
+    {"prefetch-sweep",	optional_argument,	NULL, 'J'},
+    {"dma",		required_argument,	NULL, 'a'},
+    {"dma-chunk",	required_argument,	NULL, 'b'},
+    {"dma-depth",	required_argument,	NULL, 'f'},
+    {"rw",		no_argument,		NULL, 'r'},
+    {"rw-ratio",	required_argument,	NULL, 'R'},
+    {"validate",	required_argument,	NULL, 'V'},
+    {"error-map",	required_argument,	NULL, 'E'},
+    {"init",		required_argument,	NULL, 'I'},
+    {"monitor",		required_argument,	NULL, 'M'},
+    {"monitor-count",	required_argument,	NULL, 'C'},
+    {"monitor-out",	required_argument,	NULL, 'O'},
+    {"perf",		optional_argument,	NULL, 'c'},
+    {"devices",		required_argument,	NULL, 'X'},
+    {"stripe",		required_argument,	NULL, 'G'},
+    {"map",		required_argument,	NULL, 'm'},
+    {"cache-ops",	no_argument,		NULL, 'K'},
+    {"procs",		required_argument,	NULL, 'j'},
+    {"rank",		required_argument,	NULL, 'k'},
+    {"rendezvous",	required_argument,	NULL, 'z'},
+    {"ntimes",		required_argument,	NULL, 'n'},
+    {"warmup",		required_argument,	NULL, 'w'},
+    {"format",		required_argument,	NULL, 'F'},
+    {"output",		required_argument,	NULL, 'o'},
+    {"help",		no_argument,		NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+static void print_options(void);
+static void thread_range(ssize_t n, ssize_t *lo, ssize_t *hi);
+static int parse_placement(const char *arg, char *place);
+static void set_placement(const char *place);
+static void init_arrays(ssize_t stream_array_size);
+static void zero_init(void);
+static void zero_range(STREAM_TYPE *p, ssize_t n);
+static double estimate_kernel_time(ssize_t stream_array_size);
+static void run_kernels(ssize_t stream_array_size, double *times[NKERNELS]);
+static int parse_kernels(const char *arg);
+static void list_kernels(void);
+static void set_kernels_run(const int *ids, int n);
+static int kernel_selected(int id);
+static ssize_t mix_reads(ssize_t n);
+static void summarize_times(double *times[NKERNELS]);
+static void alloc_times(double *times[NKERNELS]);
+static void free_times(double *times[NKERNELS]);
+static void sample_stats(const double *samples, int nsamples, int skip, struct time_stats *st);
+static void run_placement_sweep(ssize_t stream_array_size);
+static void run_nt_comparison(ssize_t stream_array_size, ssize_t buffer_size);
+static ssize_t parse_size(const char *arg, char **end);
+static int parse_count(const char *arg, int *v);
+static int parse_size_sweep(const char *arg);
+static void run_size_sweep(ssize_t buffer_size);
+static void run_thread_sweep(ssize_t stream_array_size);
+static void print_usage(const char *prog, ssize_t buffer_size);
+static void run_latency(ssize_t buffer_size);
+static int parse_patterns(const char *arg);
+static void run_patterns(ssize_t stream_array_size);
+static int parse_tiles(const char *arg);
+static void run_tiles(ssize_t stream_array_size);
+static void run_monitor(ssize_t stream_array_size);
+static int parse_devices(const char *arg);
+static int open_device(const char *path);
+static void run_cache_ops(ssize_t stream_array_size);
+static ssize_t coord_ctrl_bytes(void);
+static int coord_open(int fid, off_t base);
+static void coord_barrier(void);
+static void coord_gather(void);
+static void coord_close(void);
+static int parse_variant_types(const char *arg);
+static int parse_variant_unrolls(const char *arg);
+static void run_variants(ssize_t buffer_size);
+static int parse_prefetch_sweep(const char *arg);
+static void run_prefetch_sweep(ssize_t stream_array_size);
+static int parse_dma_depths(const char *arg);
+static void run_dma(ssize_t stream_array_size);
+static int trace_init(ssize_t stream_array_size);
+static void trace_kernel(int kernel, ssize_t stream_array_size, STREAM_TYPE scalar, int iter);
+static void trace_dump(void);
+static int parse_integrity(const char *arg);
+static void run_integrity(ssize_t stream_array_size);
+static int stripe_open(void);
+static STREAM_TYPE *stripe_map(ssize_t size);
+static void stripe_close(void);
+static void stripe_describe(void);
+static void run_stripe_endpoints(ssize_t stream_array_size);
+static int parse_perf_events(const char *arg);
+static int perf_init(void);
+static void perf_close(void);
+static void perf_begin(void);
+static void perf_end(int j, int k);
+static void perf_summary(void);
+static int parse_delays(const char *arg);
+static void run_loaded_latency(ssize_t stream_array_size, ssize_t buffer_size);
+static int parse_numa(const char *arg);
+static STREAM_TYPE *alloc_local(int i, ssize_t size);
+static int align_offset(const char *path, off_t *off);
+static STREAM_TYPE *map_remote(int fid, off_t off, ssize_t size);
+static void region_prefault(void *p, struct mem_region *r);
+static void region_release(STREAM_TYPE **p, struct mem_region *r);
+static void page_report(const char *name, const void *p);
+static int numa_setup(ssize_t buffer_size);
+static void numa_repin(void);
+static void numa_describe(void);
+static void run_numa_matrix(ssize_t stream_array_size, ssize_t buffer_size);
+static int report_open(const char *format, const char *path);
+static void report_meta(const char *key, int is_number, const char *fmt, ...);
+static void report_kernel(const char *group, const char *kernel, double nbytes,
+    const double *samples, int nsamples);
+static void report_kernels(const char *group, double *times[NKERNELS], ssize_t stream_array_size);
+static int baseline_compare(const char *path);
+static void report_validation(const char *group, int errors);
+static void report_close(void);
+
 int
 main(int argc, char **argv)
     {
     int			quantum, checktick();
     int			BytesPerWord;
-    int			k;
+    int			i, k, opt;
     ssize_t		j;
-    STREAM_TYPE		scalar;
-    double		t, times[4][NTIMES];
+    double		t, setup_time, *times[NKERNELS];
+    static const char	*init_name[4] = {"fill", "page", "zero", "reuse"};
+    static const char	*prefault_name[4] = {"none", "populate", "willneed", "touch"};
+    static const char	*map_mode_name[4] = {"cached (MAP_SHARED)", "uncached (O_SYNC)",
+			    "write-combined (resource _wc)", "driver ioctl"};
     ssize_t		buffer_size=(STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE), stream_array_size;
-    ssize_t		offset=0;
+    ssize_t		offset=0, coord_base=0;
+    char		*size_arg = NULL, *dev_path = NULL, *offset_arg = NULL;
+    char		*timer_arg = "auto";
+#ifdef TUNED
+    int			lmul = 8;
+#endif
+    int			threads = 1;
+    char		*format_arg = NULL, *output_arg = NULL;
 
     /* --- SETUP --- determine precision and check timing --- */
     //swsok, for char dev mmap
-    int fid;
+    int fid = -1;
 
     buffer_size = (STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE);
 
-    printf("\nUsage: \t%s \t\t\t\t\t- Local RAM test with %ld bytes\n", argv[0], buffer_size);
-    printf("\t%s [size]\t\t\t\t- Local RAM test with [size] bytes\n", argv[0]);
-    printf("\t%s [size] [/dev/mem]\t\t- /dev/mem test with [size] and offset=0x100000000\n", argv[0]);
-    printf("\t%s [size] [/dev/mem] [offset]\t- /dev/mem test with [size] and [offset]\n\n", argv[0]);
+    while ( (opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1 ) {
+	switch (opt) {
+	case 'p':
+	    if ( parse_placement(optarg, placement) != 0 ) {
+		printf("Invalid --place=%s, expected three of L/R for a, b, c (e.g. LRR)\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'P':
+	    place_sweep = 1;
+	    break;
+	case 'T':
+	    timer_arg = optarg;
+	    break;
+	case 'L':
+#ifdef TUNED
+	    lmul = atoi(optarg);
+#else
+	    printf("--lmul only applies to a -DTUNED build\n");
+	    return 1;
+#endif
+	    break;
+	case 'N':
+	    nt_mode = 1;
+	    break;
+	case 'S':
+	    if ( parse_size_sweep(optarg) != 0 ) {
+		printf("Invalid --size-sweep=%s, expected MIN[:MAX[:STEPS]]\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 't':
+	    thread_sweep = optarg ? atoi(optarg) : -1;
+	    if ( thread_sweep == 0 ) {
+		printf("Invalid --thread-sweep=%s, expected a thread count\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'A':
+	    if ( parse_patterns(optarg) != 0 ) {
+		printf("Invalid --pattern=%s, expected a list of seq, stride:N, shuffle[:BYTES], gather, scatter\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'i':
+	    tile_mode = 1;
+	    if ( optarg && parse_tiles(optarg) != 0 ) {
+		printf("Invalid --tile=%s, expected a comma-separated list of tile sizes\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'y':
+	    if ( strcmp(optarg, "none") == 0 )
+		tile_sync = TILE_NONE;
+	    else if ( strcmp(optarg, "barrier") == 0 )
+		tile_sync = TILE_BARRIER;
+	    else if ( strcmp(optarg, "fence") == 0 )
+		tile_sync = TILE_FENCE;
+	    else {
+		printf("Invalid --tile-sync=%s, expected none, barrier or fence\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'l':
+	    latency_mode = 1;
+	    break;
+	case 'D':
+	    loaded_latency = 1;
+	    if ( optarg && parse_delays(optarg) != 0 ) {
+		printf("Invalid --loaded-latency=%s, expected a comma-separated delay list\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 's':
+	    lat_stride = parse_size(optarg, NULL);
+	    if ( lat_stride < (ssize_t)sizeof(void *) || lat_stride % sizeof(void *) != 0 ) {
+		printf("Invalid --lat-stride=%s, expected a multiple of %d bytes\n", optarg, (int) sizeof(void *));
+		return 1;
+	    }
+	    break;
+	case 'g':
+	    lat_page = parse_size(optarg, NULL);
+	    break;
+	case 'd':
+	    lat_loads = (atol(optarg) + 7) & ~7L;
+	    if ( lat_loads <= 0 ) lat_loads = 1 << 20;
+	    break;
+	case 'H':
+	    if ( strcmp(optarg, "none") == 0 ) {
+		hugepage_mode = HUGE_NONE; page_size = 4096;
+	    } else if ( strcmp(optarg, "thp") == 0 ) {
+		hugepage_mode = HUGE_THP; page_size = 2UL << 20;
+	    } else if ( strcmp(optarg, "2M") == 0 || strcmp(optarg, "2m") == 0 ) {
+		hugepage_mode = HUGE_2M; page_size = 2UL << 20;
+	    } else if ( strcmp(optarg, "1G") == 0 || strcmp(optarg, "1g") == 0 ) {
+		hugepage_mode = HUGE_1G; page_size = 1UL << 30;
+	    } else {
+		printf("Invalid --hugepages=%s, expected none, thp, 2M or 1G\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'B':
+	    for (i = 0; i < 4; i++)
+		if ( strcmp(optarg, prefault_name[i]) == 0 )
+		    break;
+	    if ( i == 4 ) {
+		printf("Invalid --prefault=%s, expected none, populate, willneed or touch\n", optarg);
+		return 1;
+	    }
+	    prefault_mode = i;
+	    break;
+	case 'Z':
+	    mlock_arrays = 1;
+	    break;
+	case 'q':
+	    trace_lines = atol(optarg);
+	    if ( trace_lines <= 0 ) {
+		printf("Invalid --trace=%s, expected a number of cache lines\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'v':
+	    trace_path = optarg;
+	    break;
+	case '0':
+	    baseline_path = optarg;
+	    break;
+	case '1':
+	    i = sscanf(optarg, "%lf:%lf", &baseline_tolerance, &baseline_alpha);
+	    if ( i < 1 || baseline_tolerance < 0 || baseline_alpha <= 0 || baseline_alpha >= 1 ) {
+		printf("Invalid --tolerance=%s, expected PERCENT[:ALPHA]\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'x':
+	    if ( parse_integrity(optarg ? optarg : "all") != 0 ) {
+		printf("Invalid --integrity=%s, expected all or address,walk1,walk0,random[:SEED]\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'u':
+	    if ( parse_numa(optarg) != 0 ) {
+		printf("Invalid --numa=%s, expected firsttouch, bind:NODES or interleave[:NODES]\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'U':
+	    numa_matrix = 1;
+	    if ( numa_policy == NUMA_NONE ) numa_policy = NUMA_FIRSTTOUCH;
+	    break;
+	case 'e':
+	    if ( parse_kernels(optarg) != 0 ) {
+		printf("Invalid --kernels=%s, see --kernels=list\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'Y':
+	    variant_mode = 1;
+	    if ( parse_variant_types(optarg) != 0 ) {
+		printf("Invalid --types=%s, expected all or float,double,int32,int64,v128\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'W':
+	    variant_mode = 1;
+	    if ( parse_variant_unrolls(optarg) != 0 ) {
+		printf("Invalid --unroll=%s, expected a list of 1, 2, 4 and 8\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'Q':
+	    variant_prefetch = parse_size(optarg, NULL);
+	    if ( variant_prefetch < 0 ) {
+		printf("Invalid --prefetch-dist=%s\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'J':
+	    prefetch_sweep = 1;
+	    if ( optarg && parse_prefetch_sweep(optarg) != 0 ) {
+		printf("Invalid --prefetch-sweep=%s, expected distances in bytes, e.g. 0,256,1K\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'a':
+	    dma_mode = optarg;
+	    break;
+	case 'b':
+	    dma_chunk = parse_size(optarg, NULL);
+	    if ( dma_chunk <= 0 ) {
+		printf("Invalid --dma-chunk=%s\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'f':
+	    if ( parse_dma_depths(optarg) != 0 ) {
+		printf("Invalid --dma-depth=%s, expected in-flight counts 1 .. 256, e.g. 1,4,16\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'r':
+	    if ( !kernels_given ) nkernels = NKERNELS;
+	    break;
+	case 'R':
+	    if ( !kernels_given ) nkernels = NKERNELS;
+	    if ( sscanf(optarg, "%d:%d", &rw_read, &rw_write) != 2 || rw_read < 0 || rw_write < 0 ||
+		rw_read + rw_write == 0 ) {
+		printf("Invalid --rw-ratio=%s, expected READ:WRITE lines, e.g. 2:1\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'V':
+	    validate_param = 0;
+	    if ( strcmp(optarg, "full") == 0 ) {
+		validate_mode = VALIDATE_FULL;
+		validate_param = 1;
+	    } else if ( strncmp(optarg, "every:", 6) == 0 ) {
+		validate_mode = VALIDATE_EVERY;
+		validate_param = atol(optarg + 6);
+	    } else if ( strncmp(optarg, "random:", 7) == 0 ) {
+		validate_mode = VALIDATE_RANDOM;
+		validate_param = atol(optarg + 7);
+	    }
+	    if ( validate_param < 1 ) {
+		printf("Invalid --validate=%s, expected full, every:N or random:N\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'E':
+	    error_map_bytes = parse_size(optarg, NULL);
+	    if ( error_map_bytes <= 0 ) {
+		printf("Invalid --error-map=%s\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'I':
+	    if ( strcmp(optarg, "fill") == 0 )
+		init_mode = INIT_FILL;
+	    else if ( strcmp(optarg, "page") == 0 )
+		init_mode = INIT_PAGE;
+	    else if ( strcmp(optarg, "zero") == 0 )
+		init_mode = INIT_ZERO;
+	    else if ( strcmp(optarg, "reuse") == 0 )
+		init_mode = INIT_REUSE;
+	    else {
+		printf("Invalid --init=%s, expected fill, page, zero or reuse\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'M':
+	    monitor_interval = atof(optarg);
+	    if ( monitor_interval <= 0 ) {
+		printf("Invalid --monitor=%s, expected an interval in seconds\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'C':
+	    monitor_count = atol(optarg);
+	    break;
+	case 'O':
+	    monitor_out = optarg;
+	    break;
+	case 'c':
+	    perf_mode = 1;
+	    if ( optarg && parse_perf_events(optarg) != 0 ) {
+		printf("Invalid --perf=%s, expected up to 3 raw events like r1b,r2c\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'X':
+	    if ( parse_devices(optarg) != 0 ) {
+		printf("Invalid --devices=%s, expected DEV:OFFSET[:SIZE],...\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'G':
+	    stripe_bytes = parse_size(optarg, NULL);
+	    if ( stripe_bytes <= 0 ) {
+		printf("Invalid --stripe=%s\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'm':
+	    if ( strcmp(optarg, "cached") == 0 )
+		map_mode = MAPMODE_CACHED;
+	    else if ( strcmp(optarg, "sync") == 0 )
+		map_mode = MAPMODE_SYNC;
+	    else if ( strcmp(optarg, "wc") == 0 )
+		map_mode = MAPMODE_WC;
+	    else if ( strncmp(optarg, "ioctl:", 6) == 0 ) {
+		char *e;
+
+		map_mode = MAPMODE_IOCTL;
+		map_ioctl_req = strtoul(optarg + 6, &e, 0);
+		if ( *e == ':' )
+		    map_ioctl_arg = strtoul(e + 1, &e, 0);
+		if ( *e || map_ioctl_req == 0 ) {
+		    printf("Invalid --map=%s, expected ioctl:REQ[:ARG]\n", optarg);
+		    return 1;
+		}
+	    } else {
+		printf("Invalid --map=%s, expected cached, sync, wc or ioctl:REQ[:ARG]\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'K':
+	    cache_ops_mode = 1;
+	    break;
+	case 'j':
+	    coord_procs = atoi(optarg);
+	    if ( coord_procs < 1 || coord_procs > COORD_MAX ) {
+		printf("Invalid --procs=%s, expected 1 .. %d\n", optarg, COORD_MAX);
+		return 1;
+	    }
+	    break;
+	case 'k':
+	    coord_rank = atoi(optarg);
+	    break;
+	case 'z':
+	    coord_rendezvous = optarg;
+	    coord_tcp = strcmp(optarg, "shm") != 0;
+	    if ( coord_tcp && (strrchr(optarg, ':') == NULL || strrchr(optarg, ':')[1] == '\0') ) {
+		printf("Invalid --rendezvous=%s, expected shm or HOST:PORT\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'n':
+	    /* the first iteration is not counted, so at least two */
+	    if ( parse_count(optarg, &ntimes) != 0 || ntimes < 2 ) {
+		printf("Invalid --ntimes=%s, expected an integer of at least 2\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'w':
+	    if ( parse_count(optarg, &warmup) != 0 || warmup < 0 ) {
+		printf("Invalid --warmup=%s, expected a non-negative integer\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'F':
+	    format_arg = optarg;
+	    break;
+	case 'o':
+	    output_arg = optarg;
+	    break;
+	case 'h':
+	    print_usage(argv[0], buffer_size);
+	    print_options();
+	    return 0;
+	default:
+	    return 1;
+	}
+    }
+    /* these compare against the main run's Copy..Triad or read its Triad */
+    if ( (nt_mode || nstripe > 1 || coord_procs > 1) &&
+	 !(kernel_selected(0) && kernel_selected(1) && kernel_selected(2) && kernel_selected(3)) ) {
+	printf("--nt, --devices and --procs need Copy, Scale, Add and Triad in --kernels\n");
+	return 1;
+    }
+    if ( thread_sweep && (kernels_given || nkernels != STREAM_KERNELS) ) {
+	printf("--thread-sweep runs Copy, Scale, Add and Triad only; drop --kernels and --rw\n");
+	return 1;
+    }
+    if ( numa_matrix && !kernel_selected(3) ) {
+	printf("--numa-matrix needs Triad in --kernels\n");
+	return 1;
+    }
+    if ( warmup < 0 || ntimes < warmup + 1 ) {
+	printf("--ntimes=%d must exceed --warmup=%d\n", ntimes, warmup);
+	return 1;
+    }
+    if ( coord_rank < 0 || coord_rank >= coord_procs ) {
+	printf("--rank=%d must be below --procs=%d\n", coord_rank, coord_procs);
+	return 1;
+    }
+    if ( format_arg && report_open(format_arg, output_arg) != 0 ) {
+	printf("Cannot write --format=%s (json or csv) to %s\n", format_arg, output_arg ? output_arg : "stdout");
+	return 1;
+    }
+    print_usage(argv[0], buffer_size);
+
+    if ( optind < argc ) size_arg = argv[optind];
+    if ( optind + 1 < argc ) dev_path = argv[optind + 1];
+    if ( optind + 2 < argc ) offset_arg = argv[optind + 2];
+
+    if ( timer_init(timer_arg) != 0 ) {
+	printf("Timer \"%s\" is not available on this system\n", timer_arg);
+	return 1;
+    }
+
+#ifdef TUNED
+    if ( tuned_init(lmul) != 0 ) {
+	printf("Invalid --lmul=%d, expected 1, 2, 4 or 8\n", lmul);
+	return 1;
+    }
+#endif
 
-    if ( argc > 1 ) {
-	    buffer_size = atoll(argv[1]);
+    if ( size_arg ) {
+	    buffer_size = parse_size(size_arg, NULL);
 	    if ( buffer_size <= 0 ) buffer_size = (STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE);
     }
+    if ( size_sweep_max > 0 ) buffer_size = size_sweep_max;
+    if ( size_sweep_min > buffer_size ) {
+	printf("--size-sweep minimum %ld is larger than the array size %ld\n", (long) size_sweep_min, (long) buffer_size);
+	return 1;
+    }
 
-    //buffer_size must be a multiple of page size(4kB)
-    buffer_size = (buffer_size+4095)&(~0xFFF);
+    //buffer_size must be a multiple of page size(4kB, or the --hugepages size)
+    buffer_size = (buffer_size+page_size-1)&(~(page_size-1));
 
     stream_array_size = buffer_size/sizeof(STREAM_TYPE);
-	bytes[0] = 2 * buffer_size;
-	bytes[1] = 2 * buffer_size;
-	bytes[2] = 3 * buffer_size;
-	bytes[3] = 3 * buffer_size;
+    for (j=0; j<NKERNELS; j++)
+	bytes[j] = kernel_table[j].nbytes(stream_array_size);
+
+    if ( placement[0] == '\0' )
+	strcpy(placement, (dev_path || nstripe) ? "RRR" : "LLL");
+    if ( (place_sweep || strchr(placement, PLACE_REMOTE)) && !dev_path && !nstripe ) {
+	printf("Remote placement needs a device, e.g. %s [size] /dev/mem [offset]\n", argv[0]);
+	return 1;
+    }
 
-    if ( argc > 2 ) {
-	    if ( argc > 3 ) offset = strtoll(argv[3], NULL, 0);
+    if ( coord_procs > 1 && (nstripe || (!dev_path && !coord_tcp)) ) {
+	printf("--procs needs a single device (or --rendezvous=HOST:PORT for local arrays)\n");
+	return 1;
+    }
+
+    t = mysecond();
+    if ( nstripe ) {
+	if ( stripe_open() != 0 )
+	    return 1;
+	for (i = 0; i < 3; i++) {
+		if ( place_sweep || prefetch_sweep || placement[i] == PLACE_REMOTE ) {
+			remote_array[i] = stripe_map(buffer_size);
+			if ( remote_array[i] == MAP_FAILED ) {
+				remote_array[i] = NULL;
+				return 1;
+			}
+			remote_region[i].kind = REGION_MAPPED;
+			remote_region[i].len = buffer_size;
+		}
+	}
+    } else if ( dev_path ) {
+	    if ( offset_arg ) offset = strtoll(offset_arg, NULL, 0);
 	    if ( offset <= 0 ) offset = 0x100000000;
 	    //offset must be page-aligned
-	    offset = offset & (~0xFFF);
+	    if ( align_offset(dev_path, &offset) != 0 )
+		return 1;
 
-	fid = open(argv[2], O_RDWR);
-	if (fid < 0) {
-		printf("%s is not opened\n", argv[1]);
-		return 0;
-		}
+	fid = open_device(dev_path);
+	if (fid < 0)
+		return 1;
+	if ( coord_procs > 1 ) {
+		/* this rank's sub-window, behind the shm control block */
+		coord_base = offset;
+		offset += coord_ctrl_bytes() + (off_t) coord_rank * 3 * buffer_size;
+	}
+	remote_offset = offset;
+	remote_bytes = buffer_size;
 
-	a = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fid, offset);
-	b = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fid, offset + buffer_size);
-	c = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fid, offset + 2*buffer_size);
-/*	a = mmap(NULL, (STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE), PROT_READ | PROT_WRITE, MAP_SHARED, fid, 0);
-	b = mmap(NULL, (STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE), PROT_READ | PROT_WRITE, MAP_SHARED, fid, ((STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE)+0x1000)&(~0xfff));
-	c = mmap(NULL, (STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE), PROT_READ | PROT_WRITE, MAP_SHARED, fid, 2*(((STREAM_ARRAY_SIZE+OFFSET)*sizeof(STREAM_TYPE)+0x1000)&(~0xfff)));*/
+	for (i = 0; i < 3; i++) {
+		if ( place_sweep || prefetch_sweep || placement[i] == PLACE_REMOTE ) {
+			remote_array[i] = map_remote(fid, offset + i*buffer_size, buffer_size);
+			if ( remote_array[i] == MAP_FAILED ) {
+				printf("Cannot map %ld bytes of %s at offset 0x%lx: %s\n", (long) buffer_size,
+				    dev_path, (unsigned long)(offset + i*buffer_size), strerror(errno));
+				remote_array[i] = NULL;
+				return 1;
+			}
+			remote_region[i].kind = REGION_MAPPED;
+			remote_region[i].len = buffer_size;
+		}
+	}
     }
+    if ( prefault_mode == PREFAULT_POPULATE )
+	prefault_seconds += mysecond() - t;	/* MAP_POPULATE faulted the mappings in */
+
+    if ( coord_procs > 1 && coord_open(fid, coord_base) != 0 )
+	return 1;
 
-    if ( a == NULL ) a = aligned_alloc (4096, buffer_size);
-    if ( b == NULL ) b = aligned_alloc (4096, buffer_size);
-    if ( c == NULL ) c = aligned_alloc (4096, buffer_size);
+    for (i = 0; i < 3; i++) {
+	if ( place_sweep || prefetch_sweep || placement[i] == PLACE_LOCAL ) {
+		local_array[i] = alloc_local(i, buffer_size);
+		if ( local_array[i] == NULL ) {
+			printf("Cannot allocate %ld bytes for a local array\n", (long) buffer_size);
+			return 1;
+		}
+	}
+    }
+    if ( numa_policy != NUMA_NONE && numa_setup(buffer_size) != 0 )
+	return 1;
+    if ( prefault_mode != PREFAULT_NONE || mlock_arrays ) {
+	t = mysecond();
+	for (i = 0; i < 3; i++) {
+		if ( local_array[i] ) region_prefault(local_array[i], &local_region[i]);
+		if ( remote_array[i] ) region_prefault(remote_array[i], &remote_region[i]);
+	}
+	prefault_seconds += mysecond() - t;
+    }
+    set_placement(placement);
 
     printf(HLINE);
     printf("STREAM version $Revision: 5.10 $\n");
@@ -317,8 +1147,39 @@ main(int argc, char **argv)
     printf("Total memory required = %.1f MiB (= %.1f GiB).\n",
 	(3.0) * ( (double) buffer_size / 1024.0/1024.),
 	(3.0) * ( (double) buffer_size / 1024.0/1024./1024.));
-    printf("Each kernel will be executed %d times.\n", NTIMES);
-    printf(" The *best* time for each kernel (excluding the first iteration)\n"); 
+    if ( nstripe )
+	stripe_describe();
+    else if ( dev_path )
+	printf("Remote memory: %s at offset 0x%lx\n", dev_path, (unsigned long) offset);
+    if ( dev_path || nstripe )
+	printf("Device mapping: %s\n", map_mode_name[map_mode]);
+    if ( coord_procs > 1 )
+	printf("Coordinated run: process %d of %d, %s barrier before each iteration\n",
+	    coord_rank, coord_procs, coord_tcp ? coord_rendezvous : "shared-window");
+    if ( place_sweep )
+	printf("Array placement: sweep over all L/R combinations of a, b, c\n");
+    else
+	printf("Array placement: a=%c b=%c c=%c (L=local, R=remote)\n",
+	    placement[0], placement[1], placement[2]);
+#ifdef TUNED
+    tuned_describe();
+#endif
+    numa_describe();
+    if ( kernels_given ) {
+	printf("Kernels:");
+	for (k = 0; k < nkernels; k++)
+	    printf(" %s", kernel_table[kernel_sel[k]].name);
+	if ( kernel_selected(6) )
+	    printf(", Mix with %d:%d read:write cache lines", rw_read, rw_write);
+	printf("\n");
+    } else if ( nkernels > STREAM_KERNELS )
+	printf("Read/write kernels: Read, Write and Mix with %d:%d read:write cache lines\n",
+	    rw_read, rw_write);
+    printf("Each kernel will be executed %d times.\n", ntimes);
+    if ( warmup == 1 )
+	printf(" The *best* time for each kernel (excluding the first iteration)\n"); 
+    else
+	printf(" The *best* time for each kernel (excluding the first %d iterations)\n", warmup);
     printf(" will be used to compute the reported bandwidth.\n");
 
 #ifdef _OPENMP
@@ -326,33 +1187,29 @@ main(int argc, char **argv)
 #pragma omp parallel 
     {
 #pragma omp master
-	{
-	    k = omp_get_num_threads();
-	    printf ("Number of Threads requested = %i\n",k);
-        }
+	threads = omp_get_num_threads();
     }
-#endif
-
-#ifdef _OPENMP
-	k = 0;
-#pragma omp parallel
-#pragma omp atomic 
-		k++;
-    printf ("Number of Threads counted = %i\n",k);
+    if ( thread_sweep )
+	printf ("Number of Threads: sweep 1 .. %i\n", thread_sweep > 0 ? thread_sweep : threads);
+    else
+	printf ("Number of Threads = %i\n", threads);
 #endif
 
     /* Get initial value for system clock. */
-#pragma omp parallel for
-    for (j=0; j<stream_array_size; j++) {
-	    PRINT_LOG(j);
-	    PRINT_PROGRESS("Setup initial values", j);
-	    a[j] = 1.0;
-	    b[j] = 2.0;
-	    c[j] = 0.0;
-	}
+    setup_time = mysecond();
+    init_arrays(stream_array_size);
+    setup_time = mysecond() - setup_time;
+    if ( hugepage_mode != HUGE_NONE ) {
+	printf(HLINE);
+	page_report("a[]", a);
+	page_report("b[]", b);
+	page_report("c[]", c);
+    }
 
     printf(HLINE);
 
+    printf("Timer source: %s, %.3f MHz%s\n", timer_source(), 1.0E-6 * timer_frequency(),
+	strcmp(timer_source(), "clock_gettime") ? " (calibrated against CLOCK_MONOTONIC)" : "");
     if  ( (quantum = checktick()) >= 1) 
 	printf("\rYour clock granularity/precision appears to be "
 	    "%d microseconds.\n", quantum);
@@ -367,123 +1224,5182 @@ main(int argc, char **argv)
 	    temp =  a[j];
     }
 
-    t = mysecond();
-#pragma omp parallel for
-    for (j = 0; j < stream_array_size; j++) {
-	        PRINT_LOG(j);
-	        PRINT_PROGRESS("a = a * 2.0e0", j);
-		a[j] = 2.0E0 * a[j];
-    }
-    t = 1.0E6 * (mysecond() - t);
+    t = estimate_kernel_time(stream_array_size);
+    if ( prefault_mode != PREFAULT_NONE || mlock_arrays )
+	printf("Setup: pre-fault (%s%s) %.6f s\n", prefault_name[prefault_mode],
+	    mlock_arrays ? ", mlock" : "", prefault_seconds);
+    printf("Setup: initialization (%s) %.6f s, timing estimate pass %.6f s\n",
+	init_name[init_mode], setup_time, 1.0E-6 * t);
+
+    printf("\rEach test below will take on the order"
+	" of %d microseconds.\n", (int) t  );
+    printf("   (= %d clock ticks)\n", (int) (t/quantum) );
+    printf("Increase the size of the arrays if this shows that\n");
+    printf("you are not getting at least 20 clock ticks per test.\n");
+
+    printf(HLINE);
+
+    printf("WARNING -- The above is only a rough guideline.\n");
+    printf("For best results, please be sure you know the\n");
+    printf("precision of your system timer.\n");
+    printf(HLINE);
+
+    report_meta("stream_version", 0, "5.10");
+    report_meta("bytes_per_element", 1, "%d", BytesPerWord);
+    report_meta("array_elements", 1, "%ld", (long) stream_array_size);
+    report_meta("array_bytes", 1, "%ld", (long) buffer_size);
+    report_meta("device", 0, "%s", dev_path ? dev_path : "");
+    report_meta("offset", 1, "%ld", (long) offset);
+    report_meta("placement", 0, "%s", place_sweep ? "sweep" : placement);
+    report_meta("map_mode", 0, "%s", map_mode_name[map_mode]);
+    report_meta("threads", 1, "%d", threads);
+    if ( coord_procs > 1 ) {
+	report_meta("procs", 1, "%d", coord_procs);
+	report_meta("rank", 1, "%d", coord_rank);
+    }
+    report_meta("ntimes", 1, "%d", ntimes);
+    report_meta("warmup", 1, "%d", warmup);
+    report_meta("page_size", 1, "%lu", (unsigned long) page_size);
+    if ( kernel_selected(6) )
+	report_meta("rw_ratio", 0, "%d:%d", rw_read, rw_write);
+    report_meta("validate", 0, "%s", validate_mode == VALIDATE_FULL ? "full" :
+	validate_mode == VALIDATE_EVERY ? "every" : "random");
+    report_meta("validate_param", 1, "%ld", (long) validate_param);
+    report_meta("init", 0, "%s", init_name[init_mode]);
+    report_meta("init_seconds", 1, "%.6f", setup_time);
+    report_meta("prefault", 0, "%s%s", prefault_name[prefault_mode], mlock_arrays ? "+mlock" : "");
+    report_meta("prefault_seconds", 1, "%.6f", prefault_seconds);
+    report_meta("estimate_seconds", 1, "%.6f", 1.0E-6 * t);
+    report_meta("timer_source", 0, "%s", timer_source());
+    report_meta("timer_hz", 1, "%.0f", timer_frequency());
+
+    if ( monitor_interval > 0 ) {
+	run_monitor(stream_array_size);
+    } else if ( cache_ops_mode ) {
+	run_cache_ops(stream_array_size);
+    } else if ( numa_matrix ) {
+	run_numa_matrix(stream_array_size, buffer_size);
+    } else if ( loaded_latency ) {
+	run_loaded_latency(stream_array_size, buffer_size);
+    } else if ( latency_mode ) {
+	run_latency(buffer_size);
+    } else if ( place_sweep ) {
+	run_placement_sweep(stream_array_size);
+    } else if ( size_sweep_min > 0 ) {
+	run_size_sweep(buffer_size);
+    } else if ( tile_mode ) {
+	run_tiles(stream_array_size);
+    } else if ( dma_mode ) {
+	run_dma(stream_array_size);
+    } else if ( prefetch_sweep ) {
+	run_prefetch_sweep(stream_array_size);
+    } else if ( variant_mode ) {
+	run_variants(buffer_size);
+    } else if ( integrity_mode ) {
+	run_integrity(stream_array_size);
+    } else if ( npatterns > 0 ) {
+	run_patterns(stream_array_size);
+    } else if ( thread_sweep ) {
+	run_thread_sweep(stream_array_size);
+    } else {
+    /*	--- MAIN LOOP --- repeat test cases ntimes times --- */
+
+	alloc_times(times);
+	if ( perf_mode && perf_init() != 0 ) {
+	    printf("perf_event_open failed on every thread (see /proc/sys/kernel/perf_event_paranoid), counters off\n");
+	    perf_close();
+	    perf_mode = 0;
+	}
+	if ( trace_lines > 0 && trace_init(stream_array_size) != 0 )
+	    return 1;
+	run_kernels(stream_array_size, times);
+
+    /*	--- SUMMARY --- */
+
+	summarize_times(times);
+
+	printf("\rFunction    Best Rate MB/s  Avg time     Min time     Max time\n");
+	for (k=0; k<kernels_run; k++) {
+		j = kernel_ran[k];
+		printf("%s%12.1f  %11.6f  %11.6f  %11.6f\n", kernel_table[j].label,
+		       1.0E-06 * bytes[j]/mintime[j],
+		       avgtime[j],
+		       mintime[j],
+		       maxtime[j]);
+	}
+	printf("Function    Median       p90          p99          p99.9        Std dev\n");
+	for (k=0; k<kernels_run; k++) {
+		j = kernel_ran[k];
+		printf("%s%11.6f  %11.6f  %11.6f  %11.6f  %11.6f\n", kernel_table[j].label,
+		       timestats[j].pct[0], timestats[j].pct[1], timestats[j].pct[2],
+		       timestats[j].pct[3], timestats[j].stddev);
+	}
+	printf(HLINE);
+
+	if ( perf_mode ) {
+	    perf_summary();
+	    perf_close();
+	}
+	if ( coord_procs > 1 )
+	    coord_gather();
+	if ( trace_lines > 0 )
+	    trace_dump();
+
+	report_kernels("main", times, stream_array_size);
+	free_times(times);
+
+    /* --- Check Results --- */
+	report_validation("main", checkSTREAMresults(stream_array_size));
+	printf(HLINE);
+
+	if ( nt_mode )
+	    run_nt_comparison(stream_array_size, buffer_size);
+	if ( nstripe > 1 && strchr(placement, PLACE_REMOTE) )
+	    run_stripe_endpoints(stream_array_size);
+    }
+
+    //swsok
+    for (i = 0; i < 3; i++) {
+	region_release(&local_array[i], &local_region[i]);
+	region_release(&remote_array[i], &remote_region[i]);
+    }
+    coord_close();
+    if ( fid >= 0 ) close(fid);
+    stripe_close();
+    if ( baseline_path && baseline_compare(baseline_path) != 0 )
+	exit_status = 1;
+    report_close();
+
+    return exit_status;
+}
+
+static void print_usage(const char *prog, ssize_t buffer_size)
+{
+	printf("\nUsage: \t%s \t\t\t\t\t- Local RAM test with %ld bytes\n", prog, buffer_size);
+	printf("\t%s [size]\t\t\t\t- Local RAM test with [size] bytes\n", prog);
+	printf("\t%s [size] [/dev/mem]\t\t- /dev/mem test with [size] and offset=0x100000000\n", prog);
+	printf("\t%s [size] [/dev/mem] [offset]\t- /dev/mem test with [size] and [offset]\n", prog);
+	printf("\t%s --help\t\t\t\t- list options (placement, sweeps, ...)\n\n", prog);
+}
+
+static void print_options(void)
+{
+	printf("Options:\n");
+	printf("  --place=XYZ\t\tplacement of a, b, c: L=local RAM, R=remote (device) memory,\n");
+	printf("\t\t\te.g. --place=LRR reads a locally and b, c over the interconnect\n");
+	printf("  --place-sweep\t\trun the kernels over all eight placements and print one table\n");
+	printf("  --nt\t\t\talso run the kernels with non-temporal stores and compare\n");
+	printf("\t\t\tSTREAM and link-level (write-allocate adjusted) rates\n");
+	printf("  --size-sweep=MIN[:MAX[:STEPS]]\n");
+	printf("\t\t\trun the kernels over array sizes MIN..MAX bytes (K/M/G suffixes),\n");
+	printf("\t\t\tSTEPS per octave (default 4); MAX defaults to [size]\n");
+	printf("  --pattern=LIST\t\tCopy and Triad in other orders: seq, stride:N, shuffle[:BYTES],\n");
+	printf("\t\t\tgather, scatter (comma-separated); effective and link-level MB/s\n");
+	printf("  --tile[=B,B,...]\tCopy, Triad and memcpy+fence Burst kernels in B-byte tiles handed\n");
+	printf("\t\t\tout round-robin, one table row per B (default 64 .. 4M)\n");
+	printf("  --tile-sync=MODE\tbetween tiles: none (default), barrier or fence\n");
+	printf("  --latency\t\tpointer-chase load-to-use latency over a[] (local or remote per\n");
+	printf("\t\t\t--place) for growing working sets; honours --size-sweep MIN:STEPS\n");
+	printf("  --loaded-latency[=D,D,...]\n");
+	printf("\t\t\tthread 0 chases a[] while the other threads load b[], c[] with a\n");
+	printf("\t\t\tTriad throttled by each spin delay D; prints latency vs bandwidth\n");
+	printf("  --lat-stride=BYTES\tdistance between chained slots (default 64)\n");
+	printf("  --lat-page=BYTES\tkeep the random walk within pages of this size, e.g. 2M\n");
+	printf("  --lat-loads=N\t\tdependent loads per sample (default %d)\n", 1 << 20);
+	printf("  --thread-sweep[=N]\trun the kernels at 1..N threads (default OMP_NUM_THREADS) with\n");
+	printf("\t\t\tper-thread start/stop times; prints bandwidth, imbalance, stragglers\n");
+	printf("  --devices=LIST\t\tstripe the remote arrays over DEV:OFFSET[:SIZE] regions (comma-\n");
+	printf("\t\t\tseparated) instead of [device] [offset]; prints per-endpoint rates\n");
+	printf("  --stripe=BYTES\t\tstriping granularity for --devices (default 1M)\n");
+	printf("  --map=MODE\t\tdevice mapping: cached (default), sync (O_SYNC, uncached),\n");
+	printf("\t\t\twc (sysfs resourceN_wc) or ioctl:REQ[:ARG] issued before mmap\n");
+	printf("  --cache-ops\t\tthroughput of clflush/clflushopt/clwb, cbo.clean/flush/inval or\n");
+	printf("\t\t\tdc cvac/civac over c[], on dirty and on clean lines\n");
+	printf("  --procs=N --rank=R\tcoordinated run of N processes (hosts) on disjoint sub-windows\n");
+	printf("\t\t\tof the device, aligned by a barrier; rank 0 prints the aggregate\n");
+	printf("  --rendezvous=WHERE\tbarrier for --procs: shm (control block at offset, default)\n");
+	printf("\t\t\tor HOST:PORT (TCP to numeric address HOST, rank 0 listens on PORT)\n");
+	printf("  --baseline=FILE\tcompare best and median rates with a --format=json|csv report\n");
+	printf("\t\t\tof an earlier run and exit 1 if any regressed\n");
+	printf("  --tolerance=PCT[:ALPHA] regression threshold in percent (5) and the significance\n");
+	printf("\t\t\tlevel of the Mann-Whitney test on the samples (0.05)\n");
+	printf("  --integrity[=LIST]\twrite/verify address, walk1, walk0, random[:SEED] patterns\n");
+	printf("\t\t\tover the arrays and report failing device offsets (all)\n");
+	printf("  --trace=K\t\ttimestamp every K cache lines per thread and dump the\n");
+	printf("\t\t\tbandwidth-over-time series after the run\n");
+	printf("  --trace-file=PATH\twrite the trace as CSV to PATH instead of stdout\n");
+	printf("  --prefault=MODE\t\tfault the arrays in before setup: populate (MAP_POPULATE/\n");
+	printf("\t\t\tMADV_POPULATE_WRITE), willneed (madvise hint) or touch\n");
+	printf("  --mlock\t\tmlock() the arrays\n");
+	printf("  --hugepages=MODE\tnone, thp (madvise), 2M or 1G (MAP_HUGETLB) for local arrays;\n");
+	printf("\t\t\tsizes and device mappings are aligned to that page size; the offset must be\n");
+	printf("\t\t\ta multiple of it\n");
+	printf("  --numa=POLICY\t\tlocal arrays: firsttouch, bind:NODES or interleave[:NODES]\n");
+	printf("\t\t\t(NODES like 0,2-3); OpenMP threads are pinned and the binding printed\n");
+	printf("  --numa-matrix\t\tTriad bandwidth for threads on node i and memory on node j\n");
+	printf("  --types=LIST\t\tbenchmark element variants: float, double, int32, int64, v128 (all)\n");
+	printf("  --unroll=LIST\t\tunroll depths of the variants, from 1, 2, 4, 8 (all)\n");
+	printf("  --prefetch-dist=BYTES\tsoftware prefetch this far ahead in the variants (default off)\n");
+	printf("  --prefetch-sweep[=LIST]\tTriad with prefetch.r/w (Zicbop) or __builtin_prefetch at each\n");
+	printf("\t\t\tdistance in bytes (default 0 .. 16K), best distance per region\n");
+	printf("  --dma=BACKEND\t\tCopy through a DMA engine next to the CPU loop: thread (memcpy\n");
+	printf("\t\t\thelper) or ioctl:DEV (driver shim, a[] and c[] remote)\n");
+	printf("  --dma-chunk=BYTES\tbytes per DMA descriptor (default 1M)\n");
+	printf("  --dma-depth=LIST\tdescriptors in flight, one row each (default 1,2,4,8,16)\n");
+	printf("  --kernels=LIST\t\tkernels of the main loop in this order, e.g. Copy,Triad,Read;\n");
+	printf("\t\t\t--kernels=list shows the registered ones\n");
+	printf("  --rw\t\t\talso run Read (sum of a), Write (fill c) and Mix kernels\n");
+	printf("\t\t\tto separate the request and response directions of the link\n");
+	printf("  --rw-ratio=R:W\t\tcache lines read : written by Mix (default 2:1), implies --rw\n");
+	printf("  --validate=MODE\tfull (default), every:N (every N-th cache line) or random:N\n");
+	printf("\t\t\t(N random lines); sampled runs report a confidence bound\n");
+	printf("  --error-map=BYTES\tregion size of the per-region error map printed on a failed\n");
+	printf("\t\t\tvalidation (default 1/16 of the array)\n");
+	printf("  --init=MODE\t\tarray setup: fill (default), page (page-wise per thread), zero\n");
+	printf("\t\t\t(c cleared by cbo.zero/memset) or reuse (keep a uniform pattern\n");
+	printf("\t\t\talready in the arrays, e.g. from the previous run on the device)\n");
+	printf("  --monitor=SECONDS\tkeep the arrays mapped and time one Triad every SECONDS,\n");
+	printf("\t\t\tone timestamped line per sample, until SIGINT or --monitor-count\n");
+	printf("  --monitor-count=N\tstop after N samples (default 0 = run until interrupted)\n");
+	printf("  --monitor-out=DEST\tappend samples to a file, or unix:PATH for one datagram per\n");
+	printf("\t\t\tsample on a Unix socket (default stdout)\n");
+	printf("  --perf[=rHEX,...]\tcount cycles, instructions, cache and LLC misses (plus raw\n");
+	printf("\t\t\tevents, e.g. RISC-V hpm event codes) per kernel; prints IPC,\n");
+	printf("\t\t\tmiss rates and bytes per cycle\n");
+	printf("  --ntimes=N\t\titerations per kernel, at least 2 (default %d)\n", NTIMES);
+	printf("  --warmup=W\t\tleading iterations excluded from the statistics (default 1)\n");
+	printf("  --format=FMT\t\twrite results, raw samples and run metadata as json or csv\n");
+	printf("  --output=FILE\t\tfile for --format (default stdout; the text report then goes to stderr)\n");
+	printf("  --timer=SRC\t\ttimer source: auto (default), cycle, time or clock;\n");
+	printf("\t\t\tcounters are calibrated against CLOCK_MONOTONIC at startup\n");
+#ifdef TUNED
+	printf("  --lmul=N\t\tRVV register group size for the tuned kernels: 1, 2, 4 or 8 (default)\n");
+#endif
+	printf("  --help\t\tthis list\n");
+}
+
+static int parse_placement(const char *arg, char *place)
+{
+	int i;
+
+	if (strlen(arg) != 3)
+		return -1;
+	for (i = 0; i < 3; i++) {
+		place[i] = arg[i] & ~0x20;	/* upper case */
+		if (place[i] != PLACE_LOCAL && place[i] != PLACE_REMOTE)
+			return -1;
+	}
+	place[3] = '\0';
+	return 0;
+}
+
+/* bytes with an optional binary K/M/G suffix; returns -1 on error */
+static ssize_t parse_size(const char *arg, char **end)
+{
+	unsigned long long v;
+	char *p;
+
+	v = strtoull(arg, &p, 0);
+	if (p == arg)
+		return -1;
+	switch (*p) {
+	case 'k': case 'K': v <<= 10; p++; break;
+	case 'm': case 'M': v <<= 20; p++; break;
+	case 'g': case 'G': v <<= 30; p++; break;
+	}
+	if (end)
+		*end = p;
+	return (ssize_t) v;
+}
+
+/* a whole decimal int; returns -1 on trailing junk or overflow */
+static int parse_count(const char *arg, int *v)
+{
+	char *end;
+	long n;
+
+	errno = 0;
+	n = strtol(arg, &end, 10);
+	if (end == arg || *end != '\0' || errno == ERANGE || n < INT_MIN || n > INT_MAX)
+		return -1;
+	*v = (int) n;
+	return 0;
+}
+
+static int parse_size_sweep(const char *arg)
+{
+	char *p;
+
+	size_sweep_min = parse_size(arg, &p);
+	if (size_sweep_min <= 0)
+		return -1;
+	if (*p == ':' && p[1] != ':') {
+		size_sweep_max = parse_size(p + 1, &p);
+		if (size_sweep_max < size_sweep_min)
+			return -1;
+	}
+	if (*p == ':') {
+		if (p[1] == ':')
+			p++;
+		size_sweep_steps = strtol(p + 1, &p, 0);
+		if (size_sweep_steps < 1)
+			return -1;
+	}
+	return (*p == '\0') ? 0 : -1;
+}
+
+/* point a, b, c at the local or remote backing selected by place[] */
+static void set_placement(const char *place)
+{
+	STREAM_TYPE **arrays[3] = {&a, &b, &c};
+	int i;
+
+	for (i = 0; i < 3; i++)
+		*arrays[i] = (place[i] == PLACE_REMOTE) ? remote_array[i] : local_array[i];
+}
+
+/* static block partition of [0, n) for the calling OpenMP thread */
+static void thread_range(ssize_t n, ssize_t *lo, ssize_t *hi)
+{
+	int t = 0, nt = 1;
+
+#ifdef _OPENMP
+	t = omp_get_thread_num();
+	nt = omp_get_num_threads();
+#endif
+	*lo = n * t / nt;
+	*hi = n * (t + 1) / nt;
+}
+
+/*
+ * Page size of the array backings (--hugepages):
+ *	none	4 KiB pages (aligned_alloc)
+ *	thp	2 MiB-aligned aligned_alloc + madvise(MADV_HUGEPAGE)
+ *	2M, 1G	mmap(MAP_HUGETLB) from the hugetlb pool; falls back to
+ *		thp if the pool is empty
+ * Device windows are mapped at page_size-aligned virtual addresses so
+ * the kernel can use PMD/PUD mappings for them.
+ */
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+
+static STREAM_TYPE *alloc_local(int i, ssize_t size)
+{
+	void *p;
+
+	if (hugepage_mode == HUGE_2M || hugepage_mode == HUGE_1G) {
+		int shift = (hugepage_mode == HUGE_1G) ? 30 : 21;
+
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0);
+		if (p != MAP_FAILED) {
+			local_region[i].kind = REGION_ANON;
+			local_region[i].len = size;
+			return p;
+		}
+		printf("MAP_HUGETLB with %d MiB pages failed, using transparent huge pages\n",
+		    1 << (shift - 20));
+	}
+	p = aligned_alloc(page_size, size);
+	if (p == NULL)
+		return NULL;
+	if (hugepage_mode != HUGE_NONE)
+		madvise(p, size, MADV_HUGEPAGE);
+	local_region[i].kind = REGION_HEAP;
+	local_region[i].len = size;
+	return p;
+}
+
+/*
+ * Round a device offset down to page_size, saying so.  With --hugepages
+ * the rounding could move the window by up to a GiB, so a misaligned
+ * offset is rejected instead.
+ */
+static int align_offset(const char *path, off_t *off)
+{
+	off_t aligned = *off & ~(off_t)(page_size - 1);
+
+	if (aligned == *off)
+		return 0;
+	if (page_size > 4096) {
+		printf("Offset 0x%lx of %s is not a multiple of the %lu-byte --hugepages page size\n",
+		    (unsigned long) *off, path, (unsigned long) page_size);
+		return -1;
+	}
+	printf("Offset 0x%lx of %s rounded down to 0x%lx\n", (unsigned long) *off, path,
+	    (unsigned long) aligned);
+	*off = aligned;
+	return 0;
+}
+
+/* map size bytes of fid at off, at a page_size-aligned address */
+static STREAM_TYPE *map_remote(int fid, off_t off, ssize_t size)
+{
+	int populate = (prefault_mode == PREFAULT_POPULATE) ? MAP_POPULATE : 0;
+	struct stat st;
+	char *reserve, *p;
+
+	/* past the end of a regular file the mapping would only SIGBUS on first touch */
+	if (fstat(fid, &st) == 0 && S_ISREG(st.st_mode) && off + size > st.st_size) {
+		errno = ENXIO;
+		return MAP_FAILED;
+	}
+	if (page_size <= 4096)
+		return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | populate, fid, off);
+
+	reserve = mmap(NULL, size + page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserve == MAP_FAILED)
+		return MAP_FAILED;
+	p = (char *)(((uintptr_t) reserve + page_size - 1) & ~(uintptr_t)(page_size - 1));
+	if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | populate, fid, off) == MAP_FAILED) {
+		munmap(reserve, size + page_size);
+		return MAP_FAILED;
+	}
+	if (p > reserve)
+		munmap(reserve, p - reserve);
+	if (reserve + page_size > p)
+		munmap(p + size, reserve + page_size - p);
+	return (STREAM_TYPE *) p;
+}
+
+/*
+ * Fault the pages of one array in before anything is timed (--prefault):
+ *	populate	MAP_POPULATE on the device mappings (done by mmap, the
+ *			mapping time is counted), MADV_POPULATE_WRITE or a touch
+ *			pass on local memory, after any --numa binding
+ *	willneed	madvise(MADV_WILLNEED), a hint only
+ *	touch		read and write back one word per 4 KiB page, in parallel
+ * and with --mlock keep them resident.  The time goes to prefault_seconds.
+ */
+static void region_prefault(void *p, struct mem_region *r)
+{
+	volatile char *q = p;
+	ssize_t off, len = r->len;
+
+	switch (prefault_mode) {
+	case PREFAULT_POPULATE:
+		if (r->kind == REGION_MAPPED)
+			break;
+#ifdef MADV_POPULATE_WRITE
+		if (madvise(p, len, MADV_POPULATE_WRITE) == 0)
+			break;
+#endif
+		/* fall through */
+	case PREFAULT_TOUCH:
+#pragma omp parallel for
+		for (off = 0; off < len; off += 4096)
+			q[off] = q[off];
+		break;
+	case PREFAULT_WILLNEED:
+		madvise(p, len, MADV_WILLNEED);
+		break;
+	}
+	if (mlock_arrays) {
+		if (mlock(p, len) == 0)
+			r->locked = 1;
+		else
+			printf("mlock of %ld bytes failed: %s (see ulimit -l)\n", (long) len, strerror(errno));
+	}
+}
+
+static void region_release(STREAM_TYPE **p, struct mem_region *r)
+{
+	if (*p == NULL)
+		return;
+	if (r->locked)
+		munlock(*p, r->len);
+	if (r->kind == REGION_HEAP)
+		free(*p);
+	else if (r->kind != REGION_NONE)
+		munmap(*p, r->len);
+	*p = NULL;
+	r->kind = REGION_NONE;
+	r->locked = 0;
+}
+
+/* print the page size the kernel actually used for the mapping at p (from /proc/self/smaps) */
+static void page_report(const char *name, const void *p)
+{
+	unsigned long lo, hi, v, kps = 0, huge = 0, rss = 0;
+	uintptr_t addr = (uintptr_t) p;
+	char line[512];
+	int in = 0;
+	FILE *fp;
+
+	if (p == NULL || (fp = fopen("/proc/self/smaps", "r")) == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+			if (in)
+				break;
+			in = (addr >= lo && addr < hi);
+		} else if (in) {
+			if (sscanf(line, "KernelPageSize: %lu kB", &v) == 1)
+				kps = v;
+			else if (sscanf(line, "Rss: %lu kB", &v) == 1)
+				rss = v;
+			else if (sscanf(line, "AnonHugePages: %lu kB", &v) == 1 ||
+			    sscanf(line, "FilePmdMapped: %lu kB", &v) == 1 ||
+			    sscanf(line, "Shared_Hugetlb: %lu kB", &v) == 1 ||
+			    sscanf(line, "Private_Hugetlb: %lu kB", &v) == 1)
+				huge += v;
+		}
+	}
+	fclose(fp);
+	if (kps == 0)
+		return;
+	printf("Page size for %s: %lu kB pages", name, kps);
+	if (kps == 4 && huge > 0)
+		printf(", %lu of %lu kB resident in huge pages", huge, rss);
+	printf("\n");
+}
+
+/*
+ * Initialization strategies (--init):
+ *	fill	the original element loop (with PRINT progress)
+ *	page	each thread fills whole pages, no progress output
+ *	zero	as page, but c[] is cleared with cbo.zero (RISC-V Zicboz)
+ *		or memset
+ *	reuse	keep whatever uniform values the arrays already hold, e.g.
+ *		left on the device by the previous run, and validate from
+ *		them; falls back to page when they are not uniform
+ * init_a/b/c are the starting values checkSTREAMresults() models.
+ */
+static int reuse_arrays(ssize_t stream_array_size)
+{
+	ssize_t j, step = MAX((ssize_t)(page_size / sizeof(STREAM_TYPE)), 1), bad = 0;
+	STREAM_TYPE a0 = a[0], b0 = b[0], c0 = c[0];
+
+	if (!isfinite(a0) || !isfinite(b0) || !isfinite(c0) || a0 == 0 || b0 == 0 ||
+	    fabs(a0) > 1.0E200 || fabs(b0) > 1.0E200 || fabs(c0) > 1.0E200)
+		return -1;
+	/* first element of every page and the last element */
+#pragma omp parallel for reduction(+:bad)
+	for (j = 0; j < stream_array_size; j += step)
+		bad += (a[j] != a0) + (b[j] != b0) + (c[j] != c0);
+	j = stream_array_size - 1;
+	bad += (a[j] != a0) + (b[j] != b0) + (c[j] != c0);
+	if (bad)
+		return -1;
+	init_a = a0;
+	init_b = b0;
+	init_c = c0;
+	return 0;
+}
+
+static void init_arrays(ssize_t stream_array_size)
+{
+	ssize_t j, step = MAX((ssize_t)(page_size / sizeof(STREAM_TYPE)), 1), pages;
+
+	if (init_mode == INIT_REUSE) {
+		if (reuse_arrays(stream_array_size) == 0)
+			return;
+		printf("Arrays do not hold a reusable pattern, initializing page-wise\n");
+	}
+	init_a = 1.0;
+	init_b = 2.0;
+	init_c = 0.0;
+	if (init_mode == INIT_FILL) {
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++) {
+		PRINT_LOG(j);
+		PRINT_PROGRESS("Setup initial values", j);
+		a[j] = 1.0;
+		b[j] = 2.0;
+		c[j] = 0.0;
+	}
+		return;
+	}
+
+	pages = (stream_array_size + step - 1) / step;
+	if (init_mode == INIT_ZERO)
+		zero_init();
+#pragma omp parallel
+	{
+		ssize_t lo, hi, k;
+
+		thread_range(pages, &lo, &hi);
+		lo = MIN(lo * step, stream_array_size);
+		hi = MIN(hi * step, stream_array_size);
+		for (k = lo; k < hi; k++) {
+			a[k] = 1.0;
+			b[k] = 2.0;
+		}
+		if (init_mode == INIT_ZERO)
+			zero_range(c + lo, hi - lo);
+		else
+			for (k = lo; k < hi; k++)
+				c[k] = 0.0;
+	}
+}
+
+/* a = 2.0*a, timed; returns microseconds.  checkSTREAMresults() expects this pass. */
+static double estimate_kernel_time(ssize_t stream_array_size)
+{
+	ssize_t j;
+	double t;
+
+	t = mysecond();
+#pragma omp parallel for
+	for (j = 0; j < stream_array_size; j++) {
+		PRINT_LOG(j);
+		PRINT_PROGRESS("a = a * 2.0e0", j);
+		a[j] = 2.0E0 * a[j];
+	}
+	return 1.0E6 * (mysecond() - t);
+}
+
+/*
+ * Kernel bodies.  Each runs once over [0, stream_array_size) of the
+ * current a, b, c; Read and Mix keep their sums in read_sum and mix_sum.
+ */
+static void kernel_copy(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+	(void) scalar;
+#ifdef TUNED
+	tuned_STREAM_Copy(stream_array_size);
+#else
+	ssize_t j;
+
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++) {
+	    PRINT_LOG(j);
+	    PRINT_PROGRESS("COPY (c = a)", j);
+	    c[j] = a[j];
+	}
+#endif
+}
+
+static void kernel_scale(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+#ifdef TUNED
+	tuned_STREAM_Scale(scalar, stream_array_size);
+#else
+	ssize_t j;
+
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++) {
+	    PRINT_LOG(j);
+	    PRINT_PROGRESS("SCALE (b = 3.0*c)", j);
+	    b[j] = scalar*c[j];
+	}
+#endif
+}
+
+static void kernel_add(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+	(void) scalar;
+#ifdef TUNED
+	tuned_STREAM_Add(stream_array_size);
+#else
+	ssize_t j;
+
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++) {
+	    PRINT_LOG(j);
+	    PRINT_PROGRESS("ADD (c = a + b)", j);
+	    c[j] = a[j]+b[j];
+	}
+#endif
+}
+
+static void kernel_triad(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+#ifdef TUNED
+	tuned_STREAM_Triad(scalar, stream_array_size);
+#else
+	ssize_t j;
+
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++) {
+	    PRINT_LOG(j);
+	    PRINT_PROGRESS("TRIAD (a = b + 3.0*c)", j);
+	    a[j] = b[j]+scalar*c[j];
+	}
+#endif
+}
+
+static void kernel_read(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+	STREAM_TYPE sum = 0;
+	ssize_t j;
+
+	(void) scalar;
+#pragma omp parallel for reduction(+:sum)
+	for (j=0; j<stream_array_size; j++)
+	    sum += a[j];
+	read_sum = sum;
+}
+
+static void kernel_write(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+	ssize_t j;
+
+	(void) scalar;
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++)
+	    c[j] = write_value;
+}
+
+static void kernel_mix(ssize_t stream_array_size, STREAM_TYPE scalar)
+{
+	ssize_t j, l, line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1), group = rw_read + rw_write;
+	ssize_t nlines = (stream_array_size + line - 1) / line;
+	STREAM_TYPE sum = 0;
+
+	(void) scalar;
+#pragma omp parallel for reduction(+:sum) private(j)
+	for (l=0; l<nlines; l++) {
+	    ssize_t hi = MIN((l + 1) * line, stream_array_size);
+
+	    if (l % group < rw_read)
+		for (j=l*line; j<hi; j++)
+		    sum += a[j];
+	    else
+		for (j=l*line; j<hi; j++)
+		    c[j] = write_value;
+	}
+	mix_sum = sum;
+}
+
+/* elements of [0, n) the Mix kernel reads */
+static ssize_t mix_reads(ssize_t n)
+{
+	ssize_t j, line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1), group = rw_read + rw_write, count = 0;
+
+	for (j = 0; j < n; j += line)
+		if ((j / line) % group < rw_read)
+			count += MIN(line, n - j);
+	return count;
+}
+
+/* bytes moved over n elements: arrays read plus arrays written */
+static double words_1(ssize_t n) { return 1.0 * sizeof(STREAM_TYPE) * n; }
+static double words_2(ssize_t n) { return 2.0 * sizeof(STREAM_TYPE) * n; }
+static double words_3(ssize_t n) { return 3.0 * sizeof(STREAM_TYPE) * n; }
+
+/* validation models: one execution of the kernel on the expected values */
+static void model_copy(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->c = m->a;
+}
+
+static void model_scale(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->b = scalar * m->c;
+}
+
+static void model_add(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->c = m->a + m->b;
+}
+
+static void model_triad(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->a = m->b + scalar * m->c;
+}
+
+static void model_read(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->read_sum = m->a * (double) n;
+}
+
+static void model_write(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->c = write_value;
+}
+
+/* only the write lines change, so c[] is uniform only right after a Write, see parse_kernels() */
+static void model_mix(struct stream_model *m, STREAM_TYPE scalar, ssize_t n)
+{
+	m->mix_sum = m->a * (double) mix_reads(n);
+	m->c = write_value;
+}
+
+/*
+ * To add a kernel: write its body, bytes and model functions above, add
+ * an entry here and bump NKERNELS; --kernels picks it up by name.
+ */
+static const struct stream_kernel	kernel_table[NKERNELS] = {
+	{"Copy",  "Copy:      ", words_2, kernel_copy,  model_copy},
+	{"Scale", "Scale:     ", words_2, kernel_scale, model_scale},
+	{"Add",   "Add:       ", words_3, kernel_add,   model_add},
+	{"Triad", "Triad:     ", words_3, kernel_triad, model_triad},
+	{"Read",  "Read:      ", words_1, kernel_read,  model_read},
+	{"Write", "Write:     ", words_1, kernel_write, model_write},
+	{"Mix",   "Mix:       ", words_1, kernel_mix,   model_mix},
+};
+
+/* --kernels=NAME,...: the main timed loop runs these, in this order */
+static int parse_kernels(const char *arg)
+{
+	char buf[256], *tok, *save, seen[NKERNELS] = {0};
+	int j, n = 0, c_filled = 0;	/* c[] all write_value since the last Write */
+
+	if (strcmp(arg, "list") == 0) {
+		list_kernels();
+		exit(0);
+	}
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		for (j = 0; j < NKERNELS; j++)
+			if (strcasecmp(tok, kernel_table[j].name) == 0)
+				break;
+		if (j == NKERNELS || n == NKERNELS)
+			return -1;
+		if (seen[j]++)
+			return -1;	/* times[] has one row per kernel */
+		if (j == 6 && !c_filled) {
+			printf("--kernels: Mix leaves c[] half written, put Write before it "
+			    "with no Copy or Add in between\n");
+			return -1;
+		}
+		if (j == 5)
+			c_filled = 1;
+		else if (j == 0 || j == 2)	/* Copy and Add rewrite c[] */
+			c_filled = 0;
+		kernel_sel[n++] = j;
+	}
+	if (n == 0)
+		return -1;
+	nkernels = n;
+	kernels_given = 1;
+	return 0;
+}
+
+static void list_kernels(void)
+{
+	int j;
+
+	printf("Registered kernels (bytes per element):\n");
+	for (j = 0; j < NKERNELS; j++)
+		printf("  %-8s %4.0f\n", kernel_table[j].name, kernel_table[j].nbytes(1));
+}
+
+static void set_kernels_run(const int *ids, int n)
+{
+	kernel_ran = ids;
+	kernels_run = n;
+}
+
+/* is kernel id part of the --kernels selection */
+static int kernel_selected(int id)
+{
+	int s;
+
+	for (s = 0; s < nkernels; s++)
+		if (kernel_sel[s] == id)
+			return 1;
+	return 0;
+}
+
+static void run_kernels(ssize_t stream_array_size, double *times[NKERNELS])
+{
+	STREAM_TYPE scalar;
+	int k, s, j;
+
+	scalar = 3.0;
+	for (k=0; k<ntimes; k++)
+	{
+	if (coord_procs > 1) coord_barrier();
+	for (s=0; s<nkernels; s++) {
+		j = kernel_sel[s];
+		if (perf_mode) perf_begin();
+		times[j][k] = mysecond();
+		if (trace_lines > 0)
+			trace_kernel(j, stream_array_size, scalar, k);
+		else
+			kernel_table[j].body(stream_array_size, scalar);
+		times[j][k] = mysecond() - times[j][k];
+		if (perf_mode) perf_end(j, k);
+	}
+	}
+	set_kernels_run(kernel_sel, nkernels);
+}
+
+/* times[j] holds ntimes samples for kernel j */
+static void alloc_times(double *times[NKERNELS])
+{
+	int j;
+
+	for (j=0; j<NKERNELS; j++) {
+		times[j] = calloc(ntimes, sizeof(double));
+		if (times[j] == NULL) {
+			printf("Cannot allocate %d timing samples\n", ntimes);
+			exit(1);
+		}
+	}
+}
+
+static void free_times(double *times[NKERNELS])
+{
+	int j;
+
+	for (j=0; j<NKERNELS; j++)
+		free(times[j]);
+}
+
+static int cmp_double(const void *x, const void *y)
+{
+	double dx = *(const double *)x, dy = *(const double *)y;
+
+	return (dx > dy) - (dx < dy);
+}
+
+/* statistics over samples[skip..nsamples-1]; percentiles are nearest-rank */
+static void sample_stats(const double *samples, int nsamples, int skip, struct time_stats *st)
+{
+	double *sorted, var = 0;
+	int n = nsamples - skip, k, rank;
+
+	sorted = (n > 0) ? malloc(n * sizeof(double)) : NULL;
+	if (n > 0 && sorted == NULL)
+		printf("Cannot allocate %d samples for the statistics\n", n);
+	st->n = sorted ? n : 0;
+	if (sorted == NULL) {
+		st->avg = st->min = st->max = st->stddev = NAN;
+		for (k = 0; k < 4; k++)
+			st->pct[k] = NAN;
+		return;
+	}
+	memcpy(sorted, samples + skip, n * sizeof(double));
+	qsort(sorted, n, sizeof(double), cmp_double);
+	st->min = sorted[0];
+	st->max = sorted[n - 1];
+	st->avg = 0;
+	for (k = 0; k < n; k++)
+		st->avg += sorted[k];
+	st->avg /= (double) n;
+	for (k = 0; k < n; k++)
+		var += (sorted[k] - st->avg) * (sorted[k] - st->avg);
+	st->stddev = (n > 1) ? sqrt(var / (n - 1)) : 0.0;
+	for (k = 0; k < 4; k++) {
+		rank = (int) ceil(pct_level[k] / 100.0 * n);
+		st->pct[k] = sorted[MAX(rank, 1) - 1];
+	}
+	free(sorted);
+}
+
+/* fill avgtime[], mintime[], maxtime[] and timestats[] from times[][] */
+static void summarize_times(double *times[NKERNELS])
+{
+	int s, j;
+
+	for (s=0; s<kernels_run; s++) {	/* note -- skip the warm-up iterations */
+		j = kernel_ran[s];
+		sample_stats(times[j], ntimes, warmup, &timestats[j]);
+		avgtime[j] = timestats[j].avg;
+		mintime[j] = timestats[j].min;
+		maxtime[j] = timestats[j].max;
+	}
+}
+
+/*
+ * Run the four kernels once per a/b/c placement (LLL ... RRR) and print
+ * the best rates as one table, so the cost of each remote read stream
+ * and each remote write stream can be read off directly.
+ */
+static void run_placement_sweep(ssize_t stream_array_size)
+{
+	double *times[NKERNELS], rate[8][NKERNELS];
+	char place[4], group[32];
+	int p, i, j, s;
+
+	alloc_times(times);
+	for (p = 0; p < 8; p++) {
+		for (i = 0; i < 3; i++)
+			place[i] = (p & (4 >> i)) ? PLACE_REMOTE : PLACE_LOCAL;
+		place[3] = '\0';
+		set_placement(place);
+
+		init_arrays(stream_array_size);
+		estimate_kernel_time(stream_array_size);
+		run_kernels(stream_array_size, times);
+		summarize_times(times);
+		for (s = 0; s < kernels_run; s++) {
+			j = kernel_ran[s];
+			rate[p][j] = 1.0E-06 * bytes[j]/mintime[j];
+		}
+
+		snprintf(group, sizeof(group), "place:%s", place);
+		report_kernels(group, times, stream_array_size);
+		printf("a=%c b=%c c=%c: ", place[0], place[1], place[2]);
+		report_validation(group, checkSTREAMresults(stream_array_size));
+	}
+	printf(HLINE);
+
+	printf("Best Rate MB/s (L=local, R=remote)\n");
+	printf("%-11s", "Placement");
+	for (s = 0; s < kernels_run; s++)
+		printf(" %12s", kernel_table[kernel_ran[s]].name);
+	printf("\n");
+	for (p = 0; p < 8; p++) {
+		printf("a=%c b=%c c=%c",
+		    (p & 4) ? PLACE_REMOTE : PLACE_LOCAL,
+		    (p & 2) ? PLACE_REMOTE : PLACE_LOCAL,
+		    (p & 1) ? PLACE_REMOTE : PLACE_LOCAL);
+		for (s = 0; s < kernels_run; s++)
+			printf(" %12.1f", rate[p][kernel_ran[s]]);
+		printf("\n");
+	}
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Geometric array-size sweep: the arrays are set up once at the maximum
+ * size and the kernels run over growing prefixes of them, steps sizes
+ * per octave from size_sweep_min to the full buffer, so the L2 / LLC /
+ * local / remote transitions show up in one table.
+ */
+static void run_size_sweep(ssize_t buffer_size)
+{
+	double *times[NKERNELS], factor, s;
+	ssize_t n, last = 0, line = 64 / sizeof(STREAM_TYPE);
+	char group[32];
+	int j;
+
+	if (line < 1)
+		line = 1;
+	alloc_times(times);
+	factor = pow(2.0, 1.0 / size_sweep_steps);
+	printf("Size sweep: %ld .. %ld bytes per array, %d steps per octave\n",
+	    (long) size_sweep_min, (long) buffer_size, size_sweep_steps);
+	printf("Best Rate MB/s\n");
+	printf("%14s", "Array bytes");
+	for (j = 0; j < nkernels; j++)
+		printf(" %12s", kernel_table[kernel_sel[j]].name);
+	printf("\n");
+	for (s = size_sweep_min; ; s *= factor) {
+		n = (ssize_t)(s / sizeof(STREAM_TYPE) + 0.5) / line * line;
+		if (n > buffer_size / (ssize_t)sizeof(STREAM_TYPE) || s > buffer_size)
+			n = buffer_size / sizeof(STREAM_TYPE);
+		if (n < line)
+			n = line;
+		if (n == last)
+			continue;
+		last = n;
+
+		init_arrays(n);
+		estimate_kernel_time(n);
+		run_kernels(n, times);
+		summarize_times(times);
+		snprintf(group, sizeof(group), "size:%ld", (long)(n * sizeof(STREAM_TYPE)));
+		report_kernels(group, times, n);
+		printf("%14ld", (long)(n * sizeof(STREAM_TYPE)));
+		for (j = 0; j < kernels_run; j++)
+			printf(" %12.1f", 1.0E-06 * kernel_table[kernel_ran[j]].nbytes(n) / mintime[kernel_ran[j]]);
+		printf("\n");
+		if (n == buffer_size / (ssize_t)sizeof(STREAM_TYPE))
+			break;
+	}
+	printf(HLINE);
+	report_validation(group, checkSTREAMresults(n));
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Thread-scaling sweep: the kernels run at 1..thread_sweep threads and
+ * every thread stamps its own start and stop time around its static
+ * share of each kernel.  The aggregate rate gives the threads-vs-bandwidth
+ * curve; the per-thread stamps show imbalance (how much of the kernel time
+ * the average thread sits idle waiting for the slowest one) and which
+ * thread straggles.  The kernels are the plain loops even with TUNED so
+ * each thread's share is known.  If OpenMP hands out a smaller team than
+ * asked for (OMP_DYNAMIC, OMP_THREAD_LIMIT) the sweep stops there.
+ */
+struct thread_stamp {
+	double	start, stop;
+};
+static int	sweep_team;	/* smallest team seen by the thread kernels */
+
+#define THREAD_KERNEL(NAME, DST, EXPR) \
+static void NAME(ssize_t stream_array_size, STREAM_TYPE scalar, struct thread_stamp *st) \
+{ \
+	_Pragma("omp parallel") \
+	{ \
+		ssize_t lo, hi, j; \
+		int t = 0, nt = 1; \
+		thread_range(stream_array_size, &lo, &hi); \
+		THREAD_NUM(t); \
+		THREAD_COUNT(nt); \
+		if (t == 0 && nt < sweep_team) \
+			sweep_team = nt; \
+		st[t].start = mysecond(); \
+		for (j = lo; j < hi; j++) \
+			DST[j] = EXPR; \
+		st[t].stop = mysecond(); \
+	} \
+}
+#ifdef _OPENMP
+#define THREAD_NUM(t)	((t) = omp_get_thread_num())
+#define THREAD_COUNT(nt)	((nt) = omp_get_num_threads())
+#else
+#define THREAD_NUM(t)	((void) (t))
+#define THREAD_COUNT(nt)	((void) (nt))
+#endif
+
+THREAD_KERNEL(thread_STREAM_Copy, c, a[j])
+THREAD_KERNEL(thread_STREAM_Scale, b, scalar*c[j])
+THREAD_KERNEL(thread_STREAM_Add, c, a[j]+b[j])
+THREAD_KERNEL(thread_STREAM_Triad, a, b[j]+scalar*c[j])
+
+/* stamps[j][k*nthreads + t] is thread t in iteration k of kernel j */
+static void run_thread_kernels(ssize_t stream_array_size, int nthreads, double *times[NKERNELS],
+    struct thread_stamp *stamps[STREAM_KERNELS])
+{
+	STREAM_TYPE scalar = 3.0;
+	int k;
+
+	set_kernels_run(stream_order, STREAM_KERNELS);
+	for (k=0; k<ntimes; k++) {
+		times[0][k] = mysecond();
+		thread_STREAM_Copy(stream_array_size, scalar, stamps[0] + k * nthreads);
+		times[0][k] = mysecond() - times[0][k];
+
+		times[1][k] = mysecond();
+		thread_STREAM_Scale(stream_array_size, scalar, stamps[1] + k * nthreads);
+		times[1][k] = mysecond() - times[1][k];
+
+		times[2][k] = mysecond();
+		thread_STREAM_Add(stream_array_size, scalar, stamps[2] + k * nthreads);
+		times[2][k] = mysecond() - times[2][k];
+
+		times[3][k] = mysecond();
+		thread_STREAM_Triad(stream_array_size, scalar, stamps[3] + k * nthreads);
+		times[3][k] = mysecond() - times[3][k];
+	}
+}
+
+/*
+ * Imbalance of kernel j over the counted iterations: 1 - mean/max of the
+ * per-thread busy time, averaged.  *slowest is the thread that finished
+ * last most often.
+ */
+static double thread_imbalance(const struct thread_stamp *st, int nthreads, int *slowest)
+{
+	double sum = 0, busy, mean, max;
+	int k, t, last, *count;
+
+	count = calloc(nthreads, sizeof(int));
+	for (k = warmup; k < ntimes; k++) {
+		const struct thread_stamp *s = st + k * nthreads;
+
+		mean = max = 0;
+		last = 0;
+		for (t = 0; t < nthreads; t++) {
+			busy = s[t].stop - s[t].start;
+			mean += busy;
+			max = MAX(max, busy);
+			if (s[t].stop > s[last].stop)
+				last = t;
+		}
+		mean /= nthreads;
+		if (max > 0)
+			sum += 1.0 - mean / max;
+		count[last]++;
+	}
+	*slowest = 0;
+	for (t = 1; t < nthreads; t++)
+		if (count[t] > count[*slowest])
+			*slowest = t;
+	free(count);
+	return sum / (ntimes - warmup);
+}
+
+static void run_thread_sweep(ssize_t stream_array_size)
+{
+#ifdef _OPENMP
+	int max_threads = omp_get_max_threads();
+#else
+	int max_threads = 1;
+#endif
+	struct thread_stamp *stamps[STREAM_KERNELS], *last;
+	double *times[NKERNELS], *busy, imbalance, tbytes;
+	ssize_t lo, hi;
+	char group[32];
+	int nthreads, done = 0, slowest, j, k, t;
+
+	if (thread_sweep > 0)
+		max_threads = thread_sweep;
+	alloc_times(times);
+	busy = calloc(ntimes, sizeof(double));
+	for (j = 0; j < 4; j++)
+		stamps[j] = calloc((size_t) ntimes * max_threads, sizeof(struct thread_stamp));
+	last = calloc((size_t) ntimes * max_threads, sizeof(struct thread_stamp));
+
+	printf("Thread sweep: 1 .. %d threads\n", max_threads);
+	printf("Best Rate MB/s; imbalance and slowest thread are for Triad\n");
+	printf("%7s %12s %12s %12s %12s %9s %9s\n", "Threads", "Copy", "Scale", "Add", "Triad",
+	    "imbal %", "slowest");
+	for (nthreads = 1; nthreads <= max_threads; nthreads++) {
+#ifdef _OPENMP
+		omp_set_num_threads(nthreads);
+#endif
+		numa_repin();
+		init_arrays(stream_array_size);
+		estimate_kernel_time(stream_array_size);
+		sweep_team = nthreads;
+		run_thread_kernels(stream_array_size, nthreads, times, stamps);
+		if (sweep_team < nthreads) {
+			printf("OpenMP ran %d of the %d requested threads (OMP_DYNAMIC or a thread limit),"
+			    " sweep stopped\n", sweep_team, nthreads);
+			break;
+		}
+		done = nthreads;
+		memcpy(last, stamps[3], (size_t) ntimes * nthreads * sizeof(struct thread_stamp));
+		summarize_times(times);
+		imbalance = thread_imbalance(stamps[3], nthreads, &slowest);
+
+		snprintf(group, sizeof(group), "threads:%d", nthreads);
+		report_kernels(group, times, stream_array_size);
+		printf("%7d", nthreads);
+		for (j = 0; j < 4; j++)
+			printf(" %12.1f", 1.0E-06 * bytes[j]/mintime[j]);
+		printf(" %9.1f %9d\n", 100.0 * imbalance, slowest);
+
+		/* per-thread Triad busy times, so stragglers can be picked out of the results */
+		for (t = 0; t < nthreads; t++) {
+			lo = stream_array_size * t / nthreads;
+			hi = stream_array_size * (t + 1) / nthreads;
+			tbytes = kernel_table[3].nbytes(hi - lo);
+			for (k = 0; k < ntimes; k++)
+				busy[k] = stamps[3][k * nthreads + t].stop - stamps[3][k * nthreads + t].start;
+			snprintf(group, sizeof(group), "threads:%d:%d", nthreads, t);
+			report_kernel(group, kernel_table[3].name, tbytes, busy, ntimes);
+		}
+	}
+	printf(HLINE);
+
+	/* per-thread view of the largest complete run */
+	printf("Triad at %d threads: %14s %11s %11s\n", done, "Best MB/s", "Start us", "Stop us");
+	for (t = 0; t < done; t++) {
+		double best = 0, start = 0, stop = 0, t0;
+
+		lo = stream_array_size * t / done;
+		hi = stream_array_size * (t + 1) / done;
+		tbytes = kernel_table[3].nbytes(hi - lo);
+		for (k = warmup; k < ntimes; k++) {
+			const struct thread_stamp *s = last + k * done;
+			int u;
+
+			t0 = s[0].start;
+			for (u = 1; u < done; u++)
+				t0 = MIN(t0, s[u].start);
+			start += s[t].start - t0;
+			stop += s[t].stop - t0;
+			if (s[t].stop > s[t].start)
+				best = MAX(best, tbytes / (s[t].stop - s[t].start));
+		}
+		printf("  thread %-12d %14.1f %11.1f %11.1f\n", t, 1.0E-06 * best, 1.0E6 * start / (ntimes - warmup), 1.0E6 * stop / (ntimes - warmup));
+	}
+	printf(HLINE);
+	report_validation("threads", checkSTREAMresults(stream_array_size));
+	printf(HLINE);
+
+	for (j = 0; j < 4; j++)
+		free(stamps[j]);
+	free(last);
+	free(busy);
+	free_times(times);
+#ifdef _OPENMP
+	omp_set_num_threads(max_threads);
+#endif
+	numa_repin();
+}
+
+/*
+ * Pointer-chasing latency.  Each working set of a[] is cut into
+ * lat_stride-byte slots linked into one random cycle, so every load
+ * depends on the previous one and defeats the prefetchers.  With
+ * lat_page set the permutation is page-aware: pages are visited in
+ * random order and all slots of a page are visited (in random order)
+ * before moving on, which keeps the walk within lat_page-sized TLB
+ * entries (e.g. 2M for huge pages).  Working sets grow geometrically
+ * as in --size-sweep, up to the full array.
+ */
+static uint64_t	rng_state = 0x9E3779B97F4A7C15ull;
+
+/* xorshift64*, reproducible from run to run */
+static uint64_t rng_next(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static void shuffle(ssize_t *v, ssize_t n)
+{
+	ssize_t i, j, t;
+
+	for (i = n - 1; i > 0; i--) {
+		j = rng_next() % (i + 1);
+		t = v[i];
+		v[i] = v[j];
+		v[j] = t;
+	}
+}
+
+/* link the first wss bytes of base into a random cycle; returns the head */
+static void **build_chain(char *base, ssize_t wss, ssize_t stride, ssize_t page)
+{
+	ssize_t nslots = wss / stride, per_page, npages, i, p;
+	ssize_t *order, *pages;
+
+	if (page < stride || page > wss)
+		page = wss;
+	per_page = page / stride;
+	npages = nslots / per_page;
+	nslots = npages * per_page;
+
+	order = malloc(nslots * sizeof(ssize_t));
+	pages = malloc(npages * sizeof(ssize_t));
+	for (p = 0; p < npages; p++)
+		pages[p] = p;
+	shuffle(pages, npages);
+	for (p = 0; p < npages; p++) {
+		for (i = 0; i < per_page; i++)
+			order[p * per_page + i] = pages[p] * per_page + i;
+		shuffle(order + p * per_page, per_page);
+	}
+	for (i = 0; i < nslots; i++)
+		*(void **)(base + order[i] * stride) = base + order[(i + 1) % nslots] * stride;
+	p = order[0];
+	free(order);
+	free(pages);
+	return (void **)(base + p * stride);
+}
+
+static void * volatile	chase_sink;
+
+/* follow the chain for nloads dependent loads; returns seconds */
+static double chase(void **p, long nloads)
+{
+	double t;
+	long i;
+
+	t = mysecond();
+	for (i = 0; i < nloads; i += 8) {
+		p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+		p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+	}
+	t = mysecond() - t;
+	chase_sink = p;
+	return t;
+}
+
+static void run_latency(ssize_t buffer_size)
+{
+	double *samples, factor, s;
+	struct time_stats st;
+	ssize_t wss, last = 0;
+	char group[32];
+	void **head;
+	int k;
+
+	if (lat_stride < (ssize_t)sizeof(void *) || lat_stride % sizeof(void *) != 0 ||
+	    lat_stride > buffer_size) {
+		printf("Invalid --lat-stride=%ld\n", (long) lat_stride);
+		return;
+	}
+	samples = malloc(ntimes * sizeof(double));
+	factor = pow(2.0, 1.0 / size_sweep_steps);
+	printf("Pointer-chase latency over a[] (%s), %ld-byte stride, %ld loads per sample\n",
+	    placement[0] == PLACE_REMOTE ? "remote" : "local", (long) lat_stride, lat_loads);
+	if (lat_page > 0)
+		printf("Random order within %ld-byte pages, pages in random order\n", (long) lat_page);
+	else
+		printf("Random order over the whole working set\n");
+	printf("%14s %14s %14s\n", "Working set", "ns/load min", "ns/load median");
+	for (s = size_sweep_min > 0 ? size_sweep_min : 4096; ; s *= factor) {
+		wss = MIN((ssize_t)(s + 0.5), buffer_size) / lat_stride * lat_stride;
+		if (wss < lat_stride)
+			wss = lat_stride;
+		if (wss == last)
+			continue;
+		last = wss;
+
+		head = build_chain((char *) a, wss, lat_stride, lat_page);
+		chase(head, wss / lat_stride);	/* warm up: one full lap */
+		for (k = 0; k < ntimes; k++)
+			samples[k] = chase(head, lat_loads);
+		sample_stats(samples, ntimes, warmup, &st);
+		snprintf(group, sizeof(group), "latency:%ld", (long) wss);
+		report_kernel(group, "Chase", (double) lat_loads * sizeof(void *), samples, ntimes);
+		printf("%14ld %14.2f %14.2f\n", (long) wss,
+		    1.0E9 * st.min / lat_loads, 1.0E9 * st.pct[0] / lat_loads);
+		if (wss >= buffer_size / lat_stride * lat_stride)
+			break;
+	}
+	printf(HLINE);
+	free(samples);
+}
+
+/*
+ * Access-pattern engine (--pattern): Copy and Triad driven by an index
+ * array instead of j = 0..n-1.  Every pattern is a permutation of the
+ * whole array, so the usual uniform-value validation still applies:
+ *	seq		identity order (cost of the index array itself)
+ *	stride:N	every N-th element, in N passes
+ *	shuffle[:B]	B-byte blocks (default 4K) in random order, sequential inside
+ *	gather		c[j] = a[idx[j]], a[j] = b[idx[j]] + s*c[idx[j]]
+ *	scatter		c[idx[j]] = a[j], a[idx[j]] = b[j] + s*c[j]
+ * seq, stride and shuffle apply idx[j] to every array; gather and scatter
+ * use a random permutation on the read or the write side only.
+ * Effective bandwidth counts the STREAM bytes; link-level bandwidth counts
+ * one 64-byte line per change of cache line in each array stream (i.e.
+ * no reuse from the caches) plus the index array.
+ */
+/* "seq,stride:16,shuffle:4K,gather,scatter"; returns -1 on error */
+static int parse_patterns(const char *arg)
+{
+	struct access_pattern *pt;
+	char *p = (char *) arg, *e;
+	size_t len;
+
+	npatterns = 0;
+	while (*p) {
+		if (npatterns == 16)
+			return -1;
+		pt = &patterns[npatterns];
+		len = strcspn(p, ",");
+		if (len >= sizeof(pt->name))
+			return -1;
+		memcpy(pt->name, p, len);
+		pt->name[len] = '\0';
+		pt->param = 0;
+		if (strcmp(pt->name, "seq") == 0) {
+			pt->kind = PAT_SEQ;
+		} else if (strncmp(pt->name, "stride:", 7) == 0) {
+			pt->kind = PAT_STRIDE;
+			pt->param = strtol(pt->name + 7, &e, 0);
+			if (*e || pt->param < 1)
+				return -1;
+		} else if (strcmp(pt->name, "shuffle") == 0 || strncmp(pt->name, "shuffle:", 8) == 0) {
+			pt->kind = PAT_SHUFFLE;
+			pt->param = pt->name[7] ? parse_size(pt->name + 8, NULL) : 4096;
+			if (pt->param < (ssize_t)sizeof(STREAM_TYPE))
+				return -1;
+		} else if (strcmp(pt->name, "gather") == 0) {
+			pt->kind = PAT_GATHER;
+		} else if (strcmp(pt->name, "scatter") == 0) {
+			pt->kind = PAT_SCATTER;
+		} else {
+			return -1;
+		}
+		npatterns++;
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return (npatterns > 0) ? 0 : -1;
+}
+
+/* index array of n elements for pt */
+static ssize_t *build_pattern(const struct access_pattern *pt, ssize_t n)
+{
+	ssize_t *idx, *blocks, i, j, p, nb, per;
+
+	idx = malloc(n * sizeof(ssize_t));
+	if (idx == NULL)
+		return NULL;
+	switch (pt->kind) {
+	case PAT_STRIDE:
+		i = 0;
+		for (p = 0; p < pt->param; p++)
+			for (j = p; j < n; j += pt->param)
+				idx[i++] = j;
+		break;
+	case PAT_SHUFFLE:
+		per = MAX(pt->param / (ssize_t)sizeof(STREAM_TYPE), 1);
+		nb = (n + per - 1) / per;
+		blocks = malloc(nb * sizeof(ssize_t));
+		for (p = 0; p < nb; p++)
+			blocks[p] = p;
+		shuffle(blocks, nb);
+		i = 0;
+		for (p = 0; p < nb; p++)
+			for (j = blocks[p] * per; j < MIN((blocks[p] + 1) * per, n); j++)
+				idx[i++] = j;
+		free(blocks);
+		break;
+	case PAT_GATHER:
+	case PAT_SCATTER:
+		for (j = 0; j < n; j++)
+			idx[j] = j;
+		shuffle(idx, n);
+		break;
+	default:
+		for (j = 0; j < n; j++)
+			idx[j] = j;
+		break;
+	}
+	return idx;
+}
+
+/* cache lines fetched by a stream walking idx, one per change of line */
+static double pattern_lines(const ssize_t *idx, ssize_t n)
+{
+	ssize_t j, line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1);
+	double lines = 1;
+
+	for (j = 1; j < n; j++)
+		if (idx[j] / line != idx[j - 1] / line)
+			lines++;
+	return lines;
+}
+
+static void run_pattern_kernels(const struct access_pattern *pt, const ssize_t *idx,
+    ssize_t n, double *times[NKERNELS])
+{
+	STREAM_TYPE scalar = 3.0;
+	ssize_t j;
+	int k;
+
+	set_kernels_run(stream_order, STREAM_KERNELS);
+	for (k = 0; k < ntimes; k++) {
+		times[0][k] = mysecond();
+		if (pt->kind == PAT_GATHER) {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				c[j] = a[idx[j]];
+		} else if (pt->kind == PAT_SCATTER) {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				c[idx[j]] = a[j];
+		} else {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				c[idx[j]] = a[idx[j]];
+		}
+		times[0][k] = mysecond() - times[0][k];
+
+		times[3][k] = mysecond();
+		if (pt->kind == PAT_GATHER) {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				a[j] = b[idx[j]] + scalar*c[idx[j]];
+		} else if (pt->kind == PAT_SCATTER) {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				a[idx[j]] = b[j] + scalar*c[j];
+		} else {
+#pragma omp parallel for
+			for (j = 0; j < n; j++)
+				a[idx[j]] = b[idx[j]] + scalar*c[idx[j]];
+		}
+		times[3][k] = mysecond() - times[3][k];
+	}
+}
+
+/* relative error against expected, absolute when expected is 0; NaN never passes */
+static inline int value_differs(STREAM_TYPE x, STREAM_TYPE expected, STREAM_TYPE epsilon)
+{
+	STREAM_TYPE err = (expected == 0) ? fabs(x) : fabs(x / expected - 1.0);
+
+	return !(err <= epsilon);
+}
+
+/* every a[j] == aj and c[j] == cj; returns 1 on a mismatch */
+static int check_ac_results(ssize_t n, STREAM_TYPE aj, STREAM_TYPE cj)
+{
+	STREAM_TYPE epsilon = (sizeof(STREAM_TYPE) == 4) ? 1.e-6 : 1.e-13;
+	ssize_t j, ierr = 0;
+
+#pragma omp parallel for reduction(+:ierr)
+	for (j = 0; j < n; j++)
+		if (value_differs(a[j], aj, epsilon) || value_differs(c[j], cj, epsilon))
+			ierr++;
+	if (ierr)
+		printf("Failed Validation: %ld elements of a[] or c[] differ from %e, %e\n",
+		    (long) ierr, aj, cj);
+	return ierr ? 1 : 0;
+}
+
+/* Copy/Triad recurrence of run_pattern_kernels() */
+static int check_pattern_results(ssize_t n)
+{
+	STREAM_TYPE aj = 2.0 * init_a, cj = init_c;
+	int k;
+
+	for (k = 0; k < ntimes; k++) {	/* 2*a: after estimate_kernel_time() */
+		cj = aj;
+		aj = init_b + 3.0*cj;
+	}
+	return check_ac_results(n, aj, cj);
+}
+
+static void run_patterns(ssize_t stream_array_size)
+{
+	double *times[NKERNELS], seq_lines, idx_lines, link[4], eff[4];
+	ssize_t *idx;
+	char group[48];
+	int p, j, errors = 0;
+
+	alloc_times(times);
+	seq_lines = ceil((double) stream_array_size * sizeof(STREAM_TYPE) / 64);
+	printf("Access patterns: Copy and Triad, MB/s (effective = STREAM bytes, link = lines moved)\n");
+	printf("%-16s %12s %12s %12s %12s\n", "Pattern", "Copy", "Copy link", "Triad", "Triad link");
+	for (p = 0; p < npatterns; p++) {
+		const struct access_pattern *pt = &patterns[p];
+		double index_bytes = (double) stream_array_size * sizeof(ssize_t);
+
+		if ((idx = build_pattern(pt, stream_array_size)) == NULL) {
+			printf("Cannot allocate the index array for %s\n", pt->name);
+			break;
+		}
+		idx_lines = pattern_lines(idx, stream_array_size);
+		if (pt->kind == PAT_GATHER || pt->kind == PAT_SCATTER) {
+			link[0] = 64 * (idx_lines + seq_lines) + index_bytes;
+			link[3] = 64 * (pt->kind == PAT_GATHER ? 2 * idx_lines + seq_lines :
+			    idx_lines + 2 * seq_lines) + index_bytes;
+		} else {
+			link[0] = 64 * 2 * idx_lines + index_bytes;
+			link[3] = 64 * 3 * idx_lines + index_bytes;
+		}
+
+		init_arrays(stream_array_size);
+		estimate_kernel_time(stream_array_size);
+		run_pattern_kernels(pt, idx, stream_array_size, times);
+		free(idx);
+		for (j = 0; j < 4; j += 3) {
+			sample_stats(times[j], ntimes, warmup, &timestats[j]);
+			eff[j] = bytes[j] / timestats[j].min;
+			snprintf(group, sizeof(group), "pattern:%s", pt->name);
+			report_kernel(group, kernel_table[j].name, bytes[j], times[j], ntimes);
+			snprintf(group, sizeof(group), "pattern-link:%s", pt->name);
+			report_kernel(group, kernel_table[j].name, link[j], times[j], ntimes);
+		}
+		printf("%-16s %12.1f %12.1f %12.1f %12.1f\n", pt->name,
+		    1.0E-06 * eff[0], 1.0E-06 * link[0] / timestats[0].min,
+		    1.0E-06 * eff[3], 1.0E-06 * link[3] / timestats[3].min);
+		errors += check_pattern_results(stream_array_size);
+	}
+	printf(HLINE);
+	if (errors == 0)
+		printf("Solution Validates: all patterns\n");
+	report_validation("pattern", errors);
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Tiled execution (--tile): the arrays are cut into tile-byte pieces
+ * handed out round-robin, so each round has one tile per thread in
+ * flight, and after every tile the threads optionally meet at a barrier
+ * or issue a full fence (--tile-sync).  Besides Copy and Triad, a Burst
+ * kernel moves each tile with one memcpy followed by a fence, the way a
+ * DMA engine issues a burst and waits for its completion, so the rate
+ * for each burst length shows the link's request-size sensitivity.
+ */
+static ssize_t	tile_sizes[32] = {64, 256, 1024, 4096, 16384, 65536, 262144, 1 << 20, 4 << 20};
+static int	ntile_sizes = 9;
+
+static int parse_tiles(const char *arg)
+{
+	char *p = (char *) arg;
+
+	ntile_sizes = 0;
+	while (*p && ntile_sizes < 32) {
+		tile_sizes[ntile_sizes] = parse_size(p, &p);
+		if (tile_sizes[ntile_sizes++] < (ssize_t)sizeof(STREAM_TYPE))
+			return -1;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return (ntile_sizes > 0) ? 0 : -1;
+}
+
+#define TILE_KERNEL(NAME, BODY) \
+static void NAME(ssize_t stream_array_size, ssize_t tile, STREAM_TYPE scalar) \
+{ \
+	_Pragma("omp parallel") \
+	{ \
+		ssize_t ntiles = (stream_array_size + tile - 1) / tile, r, i, j, lo, hi; \
+		int t = 0, nt = 1; \
+		THREAD_NUM(t); \
+		THREAD_COUNT(nt); \
+		for (r = 0; r < (ntiles + nt - 1) / nt; r++) { \
+			i = r * nt + t; \
+			if (i < ntiles) { \
+				lo = i * tile; \
+				hi = MIN(lo + tile, stream_array_size); \
+				BODY; \
+			} \
+			if (tile_sync == TILE_BARRIER) { \
+				_Pragma("omp barrier") \
+			} else if (tile_sync == TILE_FENCE) { \
+				__atomic_thread_fence(__ATOMIC_SEQ_CST); \
+			} \
+		} \
+		(void) j; (void) scalar; \
+	} \
+}
+
+TILE_KERNEL(tile_STREAM_Copy, for (j = lo; j < hi; j++) c[j] = a[j])
+TILE_KERNEL(tile_STREAM_Triad, for (j = lo; j < hi; j++) a[j] = b[j]+scalar*c[j])
+TILE_KERNEL(tile_STREAM_Burst,
+    memcpy(&c[lo], &a[lo], (hi - lo) * sizeof(STREAM_TYPE));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST))
+
+static void run_tiles(ssize_t stream_array_size)
+{
+	static const char *sync_name[3] = {"none", "barrier", "fence"};
+	double *times[NKERNELS], rate[3], burst_us;
+	struct time_stats st;
+	ssize_t tile, ntiles;
+	char group[32];
+	int i, j, k, errors = 0, nthreads = 1;
+	STREAM_TYPE aj, cj;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp master
+	nthreads = omp_get_num_threads();
+#endif
+	alloc_times(times);
+	printf("Tiled execution, sync between tiles: %s\n", sync_name[tile_sync]);
+	printf("%12s %12s %12s %12s %12s\n", "Tile bytes", "Copy MB/s", "Triad MB/s", "Burst MB/s",
+	    "us/burst");
+	for (i = 0; i < ntile_sizes; i++) {
+		tile = MAX(tile_sizes[i] / (ssize_t)sizeof(STREAM_TYPE), 1);
+		ntiles = (stream_array_size + tile - 1) / tile;
+
+		init_arrays(stream_array_size);
+		estimate_kernel_time(stream_array_size);
+		for (k = 0; k < ntimes; k++) {
+			times[0][k] = mysecond();
+			tile_STREAM_Copy(stream_array_size, tile, 3.0);
+			times[0][k] = mysecond() - times[0][k];
+
+			times[1][k] = mysecond();
+			tile_STREAM_Triad(stream_array_size, tile, 3.0);
+			times[1][k] = mysecond() - times[1][k];
+
+			times[2][k] = mysecond();
+			tile_STREAM_Burst(stream_array_size, tile, 3.0);
+			times[2][k] = mysecond() - times[2][k];
+		}
+
+		snprintf(group, sizeof(group), "tile:%ld", (long)(tile * sizeof(STREAM_TYPE)));
+		for (j = 0; j < 3; j++) {
+			static const int kernel_bytes[3] = {2, 3, 2};
+			static const char *name[3] = {"Copy", "Triad", "Burst"};
+			double nbytes = kernel_bytes[j] * sizeof(STREAM_TYPE) * (double) stream_array_size;
+
+			sample_stats(times[j], ntimes, warmup, &st);
+			rate[j] = nbytes / st.min;
+			report_kernel(group, name[j], nbytes, times[j], ntimes);
+			if (j == 2)
+				burst_us = 1.0E6 * st.min / ((ntiles + nthreads - 1) / nthreads);
+		}
+		printf("%12ld %12.1f %12.1f %12.1f %12.3f\n", (long)(tile * sizeof(STREAM_TYPE)),
+		    1.0E-06 * rate[0], 1.0E-06 * rate[1], 1.0E-06 * rate[2], burst_us);
+
+		aj = 2.0 * init_a;	/* after estimate_kernel_time() */
+		cj = init_c;
+		for (k = 0; k < ntimes; k++) {
+			cj = aj;
+			aj = init_b + 3.0*cj;
+			cj = aj;
+		}
+		errors += check_ac_results(stream_array_size, aj, cj);
+	}
+	printf(HLINE);
+	if (errors == 0)
+		printf("Solution Validates: all tile sizes\n");
+	report_validation("tile", errors);
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Monitor mode (--monitor=SECONDS): the arrays stay mapped and one Triad
+ * pass is timed every SECONDS until --monitor-count samples were taken
+ * (0 = until SIGINT/SIGTERM).  Each sample is a line
+ *	<UTC time> <unix time> Triad <MB/s> <seconds>
+ * on stdout, appended to --monitor-out=FILE, or sent as one datagram per
+ * sample to --monitor-out=unix:PATH.
+ */
+static volatile sig_atomic_t	monitor_stop = 0;
+
+static void monitor_signal(int sig)
+{
+	(void) sig;
+	monitor_stop = 1;
+}
+
+static void run_monitor(ssize_t stream_array_size)
+{
+	struct sockaddr_un addr;
+	struct timespec next, now;
+	struct tm tm;
+	double *samples = NULL, t, nbytes = bytes[3];
+	STREAM_TYPE scalar = 3.0;
+	long nsamples = 0, cap = 0;
+	char line[160], stamp[32];
+	FILE *out = stdout;
+	int sock = -1, len;
+	ssize_t j;
+
+	if (monitor_out && strncmp(monitor_out, "unix:", 5) == 0) {
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, monitor_out + 5, sizeof(addr.sun_path) - 1);
+		if ((sock = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+			perror("socket");
+			return;
+		}
+	} else if (monitor_out && (out = fopen(monitor_out, "a")) == NULL) {
+		printf("Cannot open --monitor-out=%s\n", monitor_out);
+		return;
+	}
+	signal(SIGINT, monitor_signal);
+	signal(SIGTERM, monitor_signal);
+	printf("Monitor: Triad every %.3f s%s, output to %s\n", monitor_interval,
+	    monitor_count ? "" : " until interrupted", monitor_out ? monitor_out : "stdout");
+	printf(HLINE);
+	fflush(stdout);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!monitor_stop && (monitor_count == 0 || nsamples < monitor_count)) {
+		t = mysecond();
+#pragma omp parallel for
+		for (j=0; j<stream_array_size; j++)
+			a[j] = b[j]+scalar*c[j];
+		t = mysecond() - t;
+
+		if (nsamples == cap) {
+			cap = cap ? 2 * cap : 1024;
+			samples = realloc(samples, cap * sizeof(double));
+		}
+		samples[nsamples++] = t;
+
+		clock_gettime(CLOCK_REALTIME, &now);
+		gmtime_r(&now.tv_sec, &tm);
+		strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+		len = snprintf(line, sizeof(line), "%s.%03ldZ %ld.%03ld Triad %.1f %.6f\n", stamp,
+		    now.tv_nsec / 1000000, (long) now.tv_sec, now.tv_nsec / 1000000,
+		    1.0E-06 * nbytes / t, t);
+		if (sock >= 0)
+			sendto(sock, line, len, 0, (struct sockaddr *) &addr, sizeof(addr));
+		else {
+			fputs(line, out);
+			fflush(out);
+		}
+
+		next.tv_sec += (time_t) monitor_interval;
+		next.tv_nsec += (long)((monitor_interval - (time_t) monitor_interval) * 1.0E9);
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		while (!monitor_stop && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0)
+			;
+	}
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	if (sock >= 0)
+		close(sock);
+	else if (out != stdout)
+		fclose(out);
+
+	printf(HLINE);
+	printf("Monitor: %ld samples\n", nsamples);
+	if (nsamples <= warmup)
+		printf("Monitor: no samples past --warmup=%d, no statistics reported\n", warmup);
+	else {
+		set_kernels_run(stream_order, STREAM_KERNELS);
+		report_kernel("monitor", kernel_table[3].name, nbytes, samples, nsamples);
+	}
+	j = check_ac_results(stream_array_size, init_b + scalar * init_c, init_c);
+	if (j == 0)
+		printf("Solution Validates: a = b + 3.0*c on all elements\n");
+	report_validation("monitor", j);
+	printf(HLINE);
+	free(samples);
+}
+
+/*
+ * Hardware counters (--perf[=EVENTS]).  Every OpenMP thread opens one
+ * perf_event_open group on itself (user space only) with cycles,
+ * instructions, cache references/misses and LLC load misses, plus any
+ * raw events given as rHEX (on RISC-V these are the SBI PMU event codes
+ * behind the hpmcounters).  run_kernels() reads all groups around each
+ * kernel and the deltas of the counted iterations are summed per kernel,
+ * scaled for multiplexing, to give IPC, miss rates and bytes per cycle.
+ */
+#define PERF_MAX_EVENTS		8
+#define PERF_MAX_THREADS	256
+
+struct perf_event_desc {
+	uint32_t	type;
+	uint64_t	config;
+	char		name[24];
+};
+static struct perf_event_desc	perf_events[PERF_MAX_EVENTS] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, "cache-references"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses"},
+	{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "LLC-load-misses"},
+};
+static int	perf_nevents = 5;
+static int	perf_nthreads = 0, perf_counted = 0;	/* threads, threads with a group */
+static int	perf_leader[PERF_MAX_THREADS];			/* -1 = thread not counted */
+static int	perf_fd[PERF_MAX_THREADS][PERF_MAX_EVENTS];
+static int	perf_slot[PERF_MAX_THREADS][PERF_MAX_EVENTS];	/* position in the group, -1 = not counted */
+static double	perf_start[PERF_MAX_THREADS][PERF_MAX_EVENTS];
+static double	perf_count[NKERNELS][PERF_MAX_EVENTS];
+
+/* append raw events "r1b,r2c"; returns -1 on error */
+static int parse_perf_events(const char *arg)
+{
+	char *p = (char *) arg;
+
+	while (*p) {
+		if (*p != 'r' || perf_nevents == PERF_MAX_EVENTS)
+			return -1;
+		perf_events[perf_nevents].type = PERF_TYPE_RAW;
+		perf_events[perf_nevents].config = strtoull(p + 1, &p, 16);
+		snprintf(perf_events[perf_nevents].name, sizeof(perf_events[0].name), "r%llx",
+		    (unsigned long long) perf_events[perf_nevents].config);
+		perf_nevents++;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return 0;
+}
+
+/* returns -1 if no thread could open its group; threads that failed are listed and not counted */
+static int perf_init(void)
+{
+	int opened = 0, t;
+
+#pragma omp parallel reduction(+:opened)
+	{
+		struct perf_event_attr attr;
+		int t = 0, nt = 1, e, fd, n = 0;
+
+		THREAD_NUM(t);
+		THREAD_COUNT(nt);
+#pragma omp master
+		perf_nthreads = MIN(nt, PERF_MAX_THREADS);
+#pragma omp barrier
+		if (t < PERF_MAX_THREADS) {
+			perf_leader[t] = -1;
+			for (e = 0; e < perf_nevents; e++) {
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = perf_events[e].type;
+				attr.config = perf_events[e].config;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+				    PERF_FORMAT_TOTAL_TIME_RUNNING;
+				fd = syscall(SYS_perf_event_open, &attr, 0, -1, perf_leader[t], 0);
+				perf_fd[t][e] = fd;
+				perf_slot[t][e] = (fd >= 0) ? n++ : -1;
+				if (fd >= 0 && perf_leader[t] < 0)
+					perf_leader[t] = fd;
+			}
+			opened += (perf_leader[t] >= 0);
+		}
+	}
+	memset(perf_count, 0, sizeof(perf_count));
+	perf_counted = opened;
+	if (opened == 0)
+		return -1;
+	if (opened < perf_nthreads) {
+		printf("perf_event_open failed on thread");
+		for (t = 0; t < perf_nthreads; t++)
+			if (perf_leader[t] < 0)
+				printf(" %d", t);
+		printf(", counting the other %d\n", opened);
+	}
+	return 0;
+}
+
+static void perf_close(void)
+{
+	int t, e;
+
+	for (t = 0; t < perf_nthreads; t++)
+		for (e = 0; e < perf_nevents; e++)
+			if (perf_fd[t][e] >= 0) {
+				close(perf_fd[t][e]);
+				perf_fd[t][e] = -1;
+			}
+	perf_nthreads = perf_counted = 0;
+}
+
+/* scaled counts of thread t's group into v[] */
+static void perf_read(int t, double *v)
+{
+	uint64_t buf[3 + PERF_MAX_EVENTS];
+	double scale = 1.0;
+	int e;
+
+	memset(buf, 0, sizeof(buf));
+	for (e = 0; e < perf_nevents; e++)
+		v[e] = 0;
+	if (perf_leader[t] < 0 || read(perf_leader[t], buf, sizeof(buf)) < 0)
+		return;
+	if (buf[2] > 0 && buf[2] < buf[1])
+		scale = (double) buf[1] / (double) buf[2];	/* multiplexed */
+	for (e = 0; e < perf_nevents; e++)
+		v[e] = (perf_slot[t][e] >= 0) ? scale * (double) buf[3 + perf_slot[t][e]] : 0;
+}
+
+static void perf_begin(void)
+{
+	int t;
+
+	for (t = 0; t < perf_nthreads; t++)
+		perf_read(t, perf_start[t]);
+}
+
+/* add the counts since perf_begin() to kernel j unless k is a warm-up iteration */
+static void perf_end(int j, int k)
+{
+	double v[PERF_MAX_EVENTS];
+	int t, e;
+
+	if (k < warmup)
+		return;
+	for (t = 0; t < perf_nthreads; t++) {
+		perf_read(t, v);
+		for (e = 0; e < perf_nevents; e++)
+			perf_count[j][e] += v[e] - perf_start[t][e];
+	}
+}
+
+static double perf_value(int j, const char *name)
+{
+	int e;
+
+	for (e = 0; e < perf_nevents; e++)
+		if (strcmp(perf_events[e].name, name) == 0)
+			return perf_count[j][e];
+	return 0;
+}
+
+static void perf_summary(void)
+{
+	double cyc, ins, ref, miss, llc, nb, iters = ntimes - warmup;
+	char key[48];
+	int s, j, e;
+
+	printf("Counters (user space, %d of %d thread%s, per counted iteration)\n", perf_counted,
+	    perf_nthreads, perf_nthreads > 1 ? "s" : "");
+	for (e = 0; e < perf_nevents; e++) {
+		int t, have = 0;
+
+		for (t = 0; t < perf_nthreads; t++)
+			have |= (perf_slot[t][e] >= 0);
+		if (!have)
+			printf("  %s: not available, counted as 0\n", perf_events[e].name);
+	}
+	printf("Function      IPC   Cache miss %%  LLC miss/KiB  Bytes/cycle\n");
+	for (s = 0; s < kernels_run; s++) {
+		j = kernel_ran[s];
+		cyc = perf_value(j, "cycles");
+		ins = perf_value(j, "instructions");
+		ref = perf_value(j, "cache-references");
+		miss = perf_value(j, "cache-misses");
+		llc = perf_value(j, "LLC-load-misses");
+		nb = bytes[j] * iters;
+		/* cycles are summed over the counted threads; bytes per cycle of the whole machine */
+		printf("%s%6.2f  %12.2f  %12.2f  %11.3f\n", kernel_table[j].label,
+		    cyc > 0 ? ins / cyc : 0, ref > 0 ? 100.0 * miss / ref : 0,
+		    1024.0 * llc / nb, cyc > 0 ? nb * perf_counted / cyc : 0);
+		for (e = 0; e < perf_nevents; e++) {
+			snprintf(key, sizeof(key), "perf:%s:%s", kernel_table[j].name, perf_events[e].name);
+			report_meta(key, 1, "%.0f", perf_count[j][e] / iters);
+		}
+	}
+	for (e = 5; e < perf_nevents; e++) {
+		printf("%-12s", perf_events[e].name);
+		for (s = 0; s < kernels_run; s++)
+			printf(" %s=%.0f", kernel_table[kernel_ran[s]].name,
+			    perf_count[kernel_ran[s]][e] / iters);
+		printf("\n");
+	}
+	printf(HLINE);
+}
+
+/*
+ * Device mapping modes (--map):
+ *	cached	plain open(O_RDWR); caching is whatever the driver gives
+ *	sync	open(O_RDWR | O_SYNC), uncached on /dev/mem
+ *	wc	the write-combined "_wc" twin of a sysfs PCI resourceN file
+ *	ioctl:REQ[:ARG]	ioctl(fd, REQ, ARG) on the opened device before
+ *		mmap, for drivers that select the caching mode that way
+ */
+static int open_device(const char *path)
+{
+	char wc_path[512];
+	size_t len = strlen(path);
+	int fid;
+
+	if (map_mode == MAPMODE_WC && (len < 3 || strcmp(path + len - 3, "_wc") != 0)) {
+		snprintf(wc_path, sizeof(wc_path), "%s_wc", path);
+		path = wc_path;
+	}
+	fid = open(path, O_RDWR | (map_mode == MAPMODE_SYNC ? O_SYNC : 0));
+	if (fid < 0) {
+		printf("%s is not opened\n", path);
+		return -1;
+	}
+	if (map_mode == MAPMODE_IOCTL && ioctl(fid, map_ioctl_req, map_ioctl_arg) != 0) {
+		printf("%s: ioctl 0x%lx failed\n", path, map_ioctl_req);
+		close(fid);
+		return -1;
+	}
+	return fid;
+}
+
+/*
+ * Striping over several endpoints (--devices=DEV:OFFSET[:SIZE],...).
+ * Each remote array is one virtual range whose stripe_bytes-sized chunks
+ * are mapped round-robin from the regions, chunk k of every array from
+ * region k % nstripe, so the unchanged kernels interleave their traffic
+ * across the links.  Regions are consumed from OFFSET upwards (a, then
+ * b, then c); SIZE, if given, is checked.  After the aggregate run the
+ * kernels are repeated on the chunks of one endpoint at a time.
+ */
+static int parse_devices(const char *arg)
+{
+	struct stripe_region *r;
+	char *list = strdup(arg), *item, *save = NULL, *f;
+
+	nstripe = 0;
+	for (item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+		if (nstripe == 16 || (f = strchr(item, ':')) == NULL)
+			goto fail;
+		r = &stripe_regions[nstripe++];
+		*f++ = '\0';
+		snprintf(r->path, sizeof(r->path), "%s", item);
+		r->offset = strtoull(f, &f, 0);
+		r->size = 0;
+		if (*f == ':')
+			r->size = parse_size(f + 1, NULL);
+		else if (*f)
+			goto fail;
+		if (r->size < 0)
+			goto fail;
+		r->fid = -1;
+		r->used = 0;
+	}
+	free(list);
+	return (nstripe > 0) ? 0 : -1;
+fail:
+	free(list);
+	return -1;
+}
+
+static int stripe_open(void)
+{
+	int d;
+
+	stripe_bytes = (stripe_bytes + page_size - 1) & ~(page_size - 1);
+	for (d = 0; d < nstripe; d++) {
+		if (align_offset(stripe_regions[d].path, &stripe_regions[d].offset) != 0)
+			return -1;
+		if ((stripe_regions[d].fid = open_device(stripe_regions[d].path)) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* one array of size bytes striped over the regions; MAP_FAILED on error */
+static STREAM_TYPE *stripe_map(ssize_t size)
+{
+	struct stripe_region *r;
+	ssize_t k, len;
+	char *base;
+
+	base = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		return MAP_FAILED;
+	for (k = 0; k * stripe_bytes < size; k++) {
+		r = &stripe_regions[k % nstripe];
+		len = MIN(stripe_bytes, size - k * stripe_bytes);
+		if (r->size > 0 && r->used + len > r->size) {
+			printf("%s: region of %ld bytes is too small for its stripes\n", r->path, (long) r->size);
+			munmap(base, size);
+			return MAP_FAILED;
+		}
+		if (mmap(base + k * stripe_bytes, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED |
+		    (prefault_mode == PREFAULT_POPULATE ? MAP_POPULATE : 0),
+		    r->fid, r->offset + r->used) == MAP_FAILED) {
+			perror(r->path);
+			munmap(base, size);
+			return MAP_FAILED;
+		}
+		r->used += len;
+	}
+	return (STREAM_TYPE *) base;
+}
+
+static void stripe_close(void)
+{
+	int d;
+
+	for (d = 0; d < nstripe; d++)
+		if (stripe_regions[d].fid >= 0)
+			close(stripe_regions[d].fid);
+}
+
+static void stripe_describe(void)
+{
+	int d;
+
+	printf("Remote memory: striped over %d endpoint%s in %ld-byte chunks\n", nstripe,
+	    nstripe > 1 ? "s" : "", (long) stripe_bytes);
+	for (d = 0; d < nstripe; d++)
+		printf("  endpoint %d: %s at offset 0x%lx\n", d, stripe_regions[d].path,
+		    (unsigned long) stripe_regions[d].offset);
+}
+
+/* the STREAM kernels over the chunks k with k % nstripe == d */
+#define STRIPE_KERNEL(NAME, DST, EXPR) \
+static void NAME(ssize_t stream_array_size, int d, STREAM_TYPE scalar) \
+{ \
+	ssize_t chunk = stripe_bytes / sizeof(STREAM_TYPE); \
+	ssize_t nchunks = (stream_array_size + chunk - 1) / chunk, k, j, hi; \
+	_Pragma("omp parallel for private(j, hi)") \
+	for (k = d; k < nchunks; k += nstripe) { \
+		hi = MIN((k + 1) * chunk, stream_array_size); \
+		for (j = k * chunk; j < hi; j++) \
+			DST[j] = EXPR; \
+	} \
+}
+
+STRIPE_KERNEL(stripe_STREAM_Copy, c, a[j])
+STRIPE_KERNEL(stripe_STREAM_Scale, b, scalar*c[j])
+STRIPE_KERNEL(stripe_STREAM_Add, c, a[j]+b[j])
+STRIPE_KERNEL(stripe_STREAM_Triad, a, b[j]+scalar*c[j])
+
+static void run_stripe_endpoints(ssize_t stream_array_size)
+{
+	double *times[NKERNELS], aggregate[4], sum[4] = {0, 0, 0, 0}, elems, rate;
+	ssize_t chunk = stripe_bytes / sizeof(STREAM_TYPE), k;
+	STREAM_TYPE scalar = 3.0;
+	char group[32];
+	int d, j, n;
+
+	for (j = 0; j < 4; j++)
+		aggregate[j] = 1.0E-06 * bytes[j] / mintime[j];
+	alloc_times(times);
+	init_arrays(stream_array_size);
+	estimate_kernel_time(stream_array_size);
+
+	printf("Per-endpoint Best Rate MB/s (kernels on one endpoint's chunks at a time)\n");
+	printf("%-10s %12s %12s %12s %12s\n", "Endpoint", "Copy", "Scale", "Add", "Triad");
+	for (d = 0; d < nstripe; d++) {
+		elems = 0;
+		for (k = d * chunk; k < stream_array_size; k += nstripe * chunk)
+			elems += MIN(chunk, stream_array_size - k);
+		for (n = 0; n < ntimes; n++) {
+			times[0][n] = mysecond();
+			stripe_STREAM_Copy(stream_array_size, d, scalar);
+			times[0][n] = mysecond() - times[0][n];
+			times[1][n] = mysecond();
+			stripe_STREAM_Scale(stream_array_size, d, scalar);
+			times[1][n] = mysecond() - times[1][n];
+			times[2][n] = mysecond();
+			stripe_STREAM_Add(stream_array_size, d, scalar);
+			times[2][n] = mysecond() - times[2][n];
+			times[3][n] = mysecond();
+			stripe_STREAM_Triad(stream_array_size, d, scalar);
+			times[3][n] = mysecond() - times[3][n];
+		}
+		set_kernels_run(stream_order, STREAM_KERNELS);
+		summarize_times(times);
+		snprintf(group, sizeof(group), "endpoint:%d", d);
+		printf("%-10d", d);
+		for (j = 0; j < 4; j++) {
+			double nbytes = kernel_table[j].nbytes((ssize_t) elems);
+
+			report_kernel(group, kernel_table[j].name, nbytes, times[j], ntimes);
+			rate = 1.0E-06 * nbytes / mintime[j];
+			sum[j] += rate;
+			printf(" %12.1f", rate);
+		}
+		printf("\n");
+	}
+	printf("%-10s", "Aggregate");
+	for (j = 0; j < 4; j++)
+		printf(" %12.1f", aggregate[j]);
+	printf("\n%-10s", "Aggr/sum");
+	for (j = 0; j < 4; j++)
+		printf(" %11.1f%%", 100.0 * aggregate[j] / sum[j]);
+	printf("\n");
+	printf(HLINE);
+	/* every chunk went through estimate_kernel_time() and ntimes iterations */
+	report_validation("endpoint", checkSTREAMresults(stream_array_size));
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Cache maintenance throughput (--cache-ops).  c[] is dirtied with a
+ * store pass, then each available operation is timed over every cache
+ * line of it, once on dirty lines (write-back cost) and once more on the
+ * now clean lines, followed by a fence:
+ *	x86-64		clflush, clflushopt, clwb
+ *	RISC-V		cbo.clean, cbo.flush (Zicbom), cbo.inval on clean lines
+ *	AArch64		dc cvac, dc civac
+ * Availability is probed by executing the instruction once, with SIGILL
+ * caught, on a scratch line that holds no data.  This is the cost of software-managed coherence over the
+ * window, and pairs with --map=sync|wc for the uncached view.
+ */
+struct cache_op {
+	const char	*name;
+	void		(*line)(void *p);
+	int		on_dirty;	/* 0: only run on clean lines (inval would drop stores);
+					   the on_dirty ops all write dirty lines back */
+};
+
+#if defined(__x86_64__)
+static void cm_clflush(void *p) { __asm__ __volatile__ ("clflush (%0)" : : "r"(p) : "memory"); }
+static void cm_clflushopt(void *p) { __asm__ __volatile__ (".byte 0x66; clflush (%0)" : : "r"(p) : "memory"); }
+static void cm_clwb(void *p) { __asm__ __volatile__ ("clwb (%0)" : : "r"(p) : "memory"); }
+static void cm_fence(void) { __asm__ __volatile__ ("mfence" : : : "memory"); }
+static const struct cache_op	cache_ops[] = {
+	{"clflush", cm_clflush, 1},
+	{"clflushopt", cm_clflushopt, 1},
+	{"clwb", cm_clwb, 1},
+};
+#elif defined(__riscv)
+static void cm_clean(void *p) { __asm__ __volatile__ (".insn i 0x0F, 2, x0, %0, 1" : : "r"(p) : "memory"); }
+static void cm_flush(void *p) { __asm__ __volatile__ (".insn i 0x0F, 2, x0, %0, 2" : : "r"(p) : "memory"); }
+static void cm_inval(void *p) { __asm__ __volatile__ (".insn i 0x0F, 2, x0, %0, 0" : : "r"(p) : "memory"); }
+static void cm_fence(void) { __asm__ __volatile__ ("fence rw, rw" : : : "memory"); }
+static const struct cache_op	cache_ops[] = {
+	{"cbo.clean", cm_clean, 1},
+	{"cbo.flush", cm_flush, 1},
+	{"cbo.inval", cm_inval, 0},
+};
+#elif defined(__aarch64__)
+static void cm_cvac(void *p) { __asm__ __volatile__ ("dc cvac, %0" : : "r"(p) : "memory"); }
+static void cm_civac(void *p) { __asm__ __volatile__ ("dc civac, %0" : : "r"(p) : "memory"); }
+static void cm_fence(void) { __asm__ __volatile__ ("dsb sy" : : : "memory"); }
+static const struct cache_op	cache_ops[] = {
+	{"dc cvac", cm_cvac, 1},
+	{"dc civac", cm_civac, 1},
+};
+#endif
+
+/* bytes covered by one maintenance instruction */
+static ssize_t cm_line_size(void)
+{
+#if defined(__aarch64__)
+	uint64_t ctr;
+
+	__asm__ __volatile__ ("mrs %0, ctr_el0" : "=r"(ctr));
+	return 4 << ((ctr >> 16) & 0xf);	/* DminLine */
+#elif defined(__riscv) && __riscv_xlen == 64
+	struct { int64_t key; uint64_t value; } pair = {12, 0};	/* RISCV_HWPROBE_KEY_ZICBOM_BLOCK_SIZE */
+
+	if (syscall(258 /* __NR_riscv_hwprobe */, &pair, 1, 0, NULL, 0) == 0 && pair.key == 12 &&
+	    pair.value > 0)
+		return pair.value;
+	return 64;
+#else
+	return 64;
+#endif
+}
+
+#if defined(__x86_64__) || defined(__riscv) || defined(__aarch64__)
+static sigjmp_buf	cm_probe_env;
+
+static void cm_probe_handler(int sig)
+{
+	siglongjmp(cm_probe_env, 1);
+}
+
+/* returns 1 if op can be executed in user mode */
+static int cm_probe(const struct cache_op *op, void *p)
+{
+	struct sigaction sa, old_sa;
+	volatile int ok = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = cm_probe_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGILL, &sa, &old_sa);
+	if (sigsetjmp(cm_probe_env, 1) == 0) {
+		op->line(p);
+		ok = 1;
+	}
+	sigaction(SIGILL, &old_sa, NULL);
+	return ok;
+}
+
+/* time op over every line of c[]; returns seconds */
+static double cm_pass(const struct cache_op *op, ssize_t stream_array_size, ssize_t line)
+{
+	double t = mysecond();
+
+#pragma omp parallel
+	{
+		ssize_t lo, hi, nlines = stream_array_size * sizeof(STREAM_TYPE) / line, l;
+
+		thread_range(nlines, &lo, &hi);
+		for (l = lo; l < hi; l++)
+			op->line((char *) c + l * line);
+		cm_fence();
+	}
+	return mysecond() - t;
+}
+#endif
+
+static void run_cache_ops(ssize_t stream_array_size)
+{
+#if defined(__x86_64__) || defined(__riscv) || defined(__aarch64__)
+	double *dirty, *clean, nbytes = (double) stream_array_size * sizeof(STREAM_TYPE);
+	struct time_stats st_dirty, st_clean;
+	ssize_t line = cm_line_size(), j, bad = 0;
+	char group[48], *scratch;
+	int o, k, nops = sizeof(cache_ops) / sizeof(cache_ops[0]), avail[8], wb = -1;
+
+	/* probe on a line of its own, so an invalidate cannot drop live data */
+	scratch = aligned_alloc(line, line);
+	if (scratch == NULL) {
+		printf("Cannot allocate a %ld-byte probe line\n", (long) line);
+		return;
+	}
+	memset(scratch, 0, line);
+	for (o = 0; o < nops; o++) {
+		avail[o] = cm_probe(&cache_ops[o], scratch);
+		if (avail[o] && cache_ops[o].on_dirty && wb < 0)
+			wb = o;
+	}
+	free(scratch);
+
+	dirty = malloc(ntimes * sizeof(double));
+	clean = malloc(ntimes * sizeof(double));
+	printf("Cache maintenance over c[] (%s, %ld bytes), %ld-byte lines\n",
+	    c == remote_array[2] ? "remote" : "local", (long) nbytes, (long) line);
+	printf("%-12s %14s %12s %14s %12s\n", "Operation", "dirty MB/s", "ns/line", "clean MB/s", "ns/line");
+	for (o = 0; o < nops; o++) {
+		const struct cache_op *op = &cache_ops[o];
+
+		if (!avail[o]) {
+			printf("%-12s %14s\n", op->name, "not available");
+			continue;
+		}
+		if (!op->on_dirty && wb < 0) {
+			printf("%-12s %14s\n", op->name, "no write-back op to clean the lines first");
+			continue;
+		}
+		for (k = 0; k < ntimes; k++) {
+#pragma omp parallel for
+			for (j = 0; j < stream_array_size; j++)
+				c[j] = write_value;
+			if (op->on_dirty) {
+				dirty[k] = cm_pass(op, stream_array_size, line);
+			} else {
+				/* invalidating dirty lines would drop the stores: write them back first */
+				cm_pass(&cache_ops[wb], stream_array_size, line);
+				dirty[k] = 0;
+			}
+			clean[k] = cm_pass(op, stream_array_size, line);
+		}
+		sample_stats(clean, ntimes, warmup, &st_clean);
+		if (st_clean.n == 0) {
+			printf("%-12s %14s\n", op->name, "no samples");
+			continue;
+		}
+		snprintf(group, sizeof(group), "cache:%s", op->name);
+		report_kernel(group, "clean", nbytes, clean, ntimes);
+		if (op->on_dirty) {
+			sample_stats(dirty, ntimes, warmup, &st_dirty);
+			report_kernel(group, "dirty", nbytes, dirty, ntimes);
+			printf("%-12s %14.1f %12.2f", op->name, 1.0E-06 * nbytes / st_dirty.min,
+			    1.0E9 * st_dirty.min / (nbytes / line));
+		} else {
+			printf("%-12s %14s %12s", op->name, "-", "-");
+		}
+		printf(" %14.1f %12.2f\n", 1.0E-06 * nbytes / st_clean.min, 1.0E9 * st_clean.min / (nbytes / line));
+	}
+	printf(HLINE);
+
+	/* the maintenance must not have lost any of the stores */
+#pragma omp parallel for reduction(+:bad)
+	for (j = 0; j < stream_array_size; j++)
+		bad += (c[j] != write_value);
+	if (bad)
+		printf("Failed Validation: %ld elements of c[] lost their stores\n", (long) bad);
+	else
+		printf("Solution Validates: c[] intact after cache maintenance\n");
+	report_validation("cache", bad ? 1 : 0);
+	printf(HLINE);
+	free(dirty);
+	free(clean);
+#else
+	printf("Cache maintenance kernels are not supported on this target\n");
+	printf(HLINE);
+#endif
+}
+
+/*
+ * Coordinated runs (--procs=N --rank=R).  N copies of stream_c.exe,
+ * possibly on different hosts mapping the same pool, each take the
+ * disjoint sub-window offset + R * 3 * size and line up every iteration
+ * on a barrier before the timed kernels, so the fabric sees all N
+ * streams at once.  The barrier is either
+ *	shm		a control block at offset in the shared window itself
+ *			(the sub-windows start after it); each rank writes only
+ *			its own slot and rank 0 releases everyone
+ *	HOST:PORT	a TCP rendezvous with rank 0 listening on PORT
+ * At the end every rank hands its best and average rates to rank 0,
+ * which prints them with the aggregate and a fairness index.  Across
+ * hosts without hardware coherence use --map=sync for the shm barrier.
+ */
+#define COORD_MAGIC	0x53545245414d4252ULL	/* "STREAMBR" */
+struct coord_slot {
+	uint64_t	session, arrive;
+	double		best[4], avg[4];
+	char		pad[128 - 2 * sizeof(uint64_t) - 8 * sizeof(double)];
+};
+struct coord_ctrl {
+	uint64_t	magic, session, release, nprocs;
+	char		pad[128 - 4 * sizeof(uint64_t)];
+	struct coord_slot slot[COORD_MAX];
+};
+static struct coord_ctrl *coord_shm = NULL;
+static uint64_t		coord_session = 0, coord_gen = 0;
+static int		coord_fd[COORD_MAX];
+
+/* bytes of window in front of the sub-windows */
+static ssize_t coord_ctrl_bytes(void)
+{
+	if (coord_tcp)
+		return 0;
+	return (sizeof(struct coord_ctrl) + page_size - 1) & ~(page_size - 1);
+}
+
+static int coord_xfer(int fd, void *buf, size_t n, int out)
+{
+	ssize_t r;
+	size_t done = 0;
+
+	while (done < n) {
+		r = out ? send(fd, (char *) buf + done, n - done, MSG_NOSIGNAL) :
+			  recv(fd, (char *) buf + done, n - done, 0);
+		if (r <= 0)
+			return -1;
+		done += r;
+	}
+	return 0;
+}
+
+/*
+ * --rendezvous=HOST:PORT with HOST a numeric IPv4 or IPv6 address
+ * ("[::1]:PORT" also works): no resolver, so the static binary does
+ * not depend on the NSS libraries at run time.  Rank 0 listens on the
+ * wildcard address of HOST's family.
+ */
+static int coord_tcp_addr(struct sockaddr_storage *ss, socklen_t *len)
+{
+	struct sockaddr_in *in = (struct sockaddr_in *) ss;
+	struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) ss;
+	char host[256], *port, *e;
+	long p;
+
+	snprintf(host, sizeof(host), "%s", coord_rendezvous);
+	port = strrchr(host, ':');
+	*port++ = '\0';
+	p = strtol(port, &e, 10);
+	if (*e != '\0' || p < 1 || p > 65535) {
+		printf("--rendezvous=%s: bad port\n", coord_rendezvous);
+		return -1;
+	}
+	if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+		host[strlen(host) - 1] = '\0';
+		memmove(host, host + 1, strlen(host));
+	}
+	memset(ss, 0, sizeof(*ss));
+	if (inet_pton(AF_INET, host, &in->sin_addr) == 1) {
+		in->sin_family = AF_INET;
+		in->sin_port = htons(p);
+		if (coord_rank == 0)
+			in->sin_addr.s_addr = htonl(INADDR_ANY);
+		*len = sizeof(*in);
+	} else if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+		in6->sin6_family = AF_INET6;
+		in6->sin6_port = htons(p);
+		if (coord_rank == 0)
+			in6->sin6_addr = in6addr_any;
+		*len = sizeof(*in6);
+	} else {
+		printf("--rendezvous=%s: HOST must be a numeric IPv4 or IPv6 address\n", coord_rendezvous);
+		return -1;
+	}
+	return 0;
+}
+
+static int coord_tcp_open(void)
+{
+	struct sockaddr_storage ss;
+	socklen_t len;
+	int fd = -1, one = 1, r, tries;
+	int32_t rank = coord_rank;
+
+	if (coord_tcp_addr(&ss, &len) != 0)
+		return -1;
+	if (coord_rank == 0) {
+		if ((fd = socket(ss.ss_family, SOCK_STREAM, 0)) < 0) {
+			perror("rendezvous socket");
+			return -1;
+		}
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, (struct sockaddr *) &ss, len) != 0 || listen(fd, COORD_MAX) != 0) {
+			perror("rendezvous listen");
+			close(fd);
+			return -1;
+		}
+		for (r = 1; r < coord_procs; r++) {
+			int c = accept(fd, NULL, NULL);
+
+			if (c < 0 || coord_xfer(c, &rank, sizeof(rank), 0) != 0 ||
+			    rank < 1 || rank >= coord_procs || coord_fd[rank] >= 0) {
+				printf("Rendezvous: bad connection (rank %d)\n", (int) rank);
+				close(fd);
+				return -1;
+			}
+			setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			coord_fd[rank] = c;
+		}
+		close(fd);
+		return 0;
+	}
+	/* rank 0 may not be up yet: retry for a minute */
+	for (tries = 0; tries < 600 && coord_fd[0] < 0; tries++) {
+		if ((fd = socket(ss.ss_family, SOCK_STREAM, 0)) < 0)
+			break;
+		if (connect(fd, (struct sockaddr *) &ss, len) == 0)
+			coord_fd[0] = fd;
+		else {
+			close(fd);
+			usleep(100000);
+		}
+	}
+	if (coord_fd[0] < 0) {
+		printf("Rendezvous: cannot reach rank 0 at %s\n", coord_rendezvous);
+		return -1;
+	}
+	setsockopt(coord_fd[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return coord_xfer(coord_fd[0], &rank, sizeof(rank), 1);
+}
+
+/* rank 0 (re)initialises the control block and publishes a new session */
+static void coord_shm_publish(void)
+{
+	struct coord_ctrl *cc = coord_shm;
+	struct timespec ts;
+	int r;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	__atomic_store_n(&cc->session, 0, __ATOMIC_RELEASE);
+	cc->release = 0;
+	for (r = 0; r < COORD_MAX; r++)
+		cc->slot[r].session = cc->slot[r].arrive = 0;
+	cc->nprocs = coord_procs;
+	cc->magic = COORD_MAGIC;
+	coord_session = ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec) ^ ((uint64_t) getpid() << 32);
+	coord_session |= 1;
+	__atomic_store_n(&cc->session, coord_session, __ATOMIC_RELEASE);
+}
+
+static int coord_open(int fid, off_t base)
+{
+	int r;
+
+	for (r = 0; r < COORD_MAX; r++)
+		coord_fd[r] = -1;
+	if (coord_tcp)
+		return coord_tcp_open();
+	coord_shm = (struct coord_ctrl *) map_remote(fid, base, coord_ctrl_bytes());
+	if (coord_shm == MAP_FAILED) {
+		coord_shm = NULL;
+		return -1;
+	}
+	if (coord_rank == 0)
+		coord_shm_publish();
+	return 0;
+}
+
+/* non-zero ranks: adopt rank 0's current session, dropping a stale one */
+static void coord_shm_join(int gen)
+{
+	struct coord_ctrl *cc = coord_shm;
+	struct coord_slot *s = &cc->slot[coord_rank];
+	uint64_t cur = __atomic_load_n(&cc->session, __ATOMIC_ACQUIRE);
+
+	if (cur == 0 || cur == coord_session || cc->magic != COORD_MAGIC)
+		return;
+	coord_session = cur;
+	s->session = cur;
+	__atomic_store_n(&s->arrive, gen, __ATOMIC_RELEASE);
+}
+
+static void coord_barrier(void)
+{
+	struct coord_ctrl *cc = coord_shm;
+	uint64_t gen = ++coord_gen;
+	char token = 0;
+	int r;
+
+	if (coord_tcp) {
+		if (coord_rank == 0) {
+			for (r = 1; r < coord_procs; r++)
+				if (coord_xfer(coord_fd[r], &token, 1, 0) != 0)
+					goto lost;
+			for (r = 1; r < coord_procs; r++)
+				if (coord_xfer(coord_fd[r], &token, 1, 1) != 0)
+					goto lost;
+		} else if (coord_xfer(coord_fd[0], &token, 1, 1) != 0 ||
+			   coord_xfer(coord_fd[0], &token, 1, 0) != 0)
+			goto lost;
+		return;
+lost:
+		printf("Rendezvous: lost connection in barrier %lu\n", (unsigned long) gen);
+		exit(1);
+	}
+	if (coord_rank == 0) {
+		__atomic_store_n(&cc->slot[0].arrive, gen, __ATOMIC_RELEASE);
+		for (r = 1; r < coord_procs; r++)
+			while (__atomic_load_n(&cc->slot[r].session, __ATOMIC_ACQUIRE) != coord_session ||
+			       __atomic_load_n(&cc->slot[r].arrive, __ATOMIC_ACQUIRE) < gen)
+				sched_yield();
+		__atomic_store_n(&cc->release, gen, __ATOMIC_RELEASE);
+		return;
+	}
+	coord_shm_join(gen);
+	__atomic_store_n(&cc->slot[coord_rank].arrive, gen, __ATOMIC_RELEASE);
+	/* a release left over from an older session only counts after a join */
+	while (__atomic_load_n(&cc->release, __ATOMIC_ACQUIRE) < gen ||
+	       (gen == 1 && __atomic_load_n(&cc->session, __ATOMIC_ACQUIRE) != coord_session)) {
+		if (gen == 1)
+			coord_shm_join(gen);
+		sched_yield();
+	}
+}
+
+/* hand this rank's rates to rank 0 and print the per-process table there */
+static void coord_gather(void)
+{
+	double best[COORD_MAX][4], avg[COORD_MAX][4], sum, sumsq, lo, hi;
+	char msg[512], *p, key[48];
+	int r, j;
+
+	for (j = 0; j < 4; j++) {
+		best[coord_rank][j] = 1.0E-06 * bytes[j] / mintime[j];
+		avg[coord_rank][j] = 1.0E-06 * bytes[j] / avgtime[j];
+	}
+	if (coord_tcp) {
+		if (coord_rank != 0) {
+			for (p = msg, j = 0; j < 4; j++)
+				p += sprintf(p, "%.17g %.17g ", best[coord_rank][j], avg[coord_rank][j]);
+			memset(p, 0, msg + sizeof(msg) - p);
+			if (coord_xfer(coord_fd[0], msg, sizeof(msg), 1) != 0)
+				printf("Rendezvous: cannot send results to rank 0\n");
+			return;
+		}
+		for (r = 1; r < coord_procs; r++) {
+			if (coord_xfer(coord_fd[r], msg, sizeof(msg), 0) != 0) {
+				printf("Rendezvous: no results from rank %d\n", r);
+				return;
+			}
+			for (p = msg, j = 0; j < 4; j++) {
+				best[r][j] = strtod(p, &p);
+				avg[r][j] = strtod(p, &p);
+			}
+		}
+	} else {
+		struct coord_slot *s = &coord_shm->slot[coord_rank];
+
+		memcpy(s->best, best[coord_rank], sizeof(s->best));
+		memcpy(s->avg, avg[coord_rank], sizeof(s->avg));
+		coord_barrier();	/* slots are filled once everyone is past it */
+		if (coord_rank != 0)
+			return;
+		for (r = 1; r < coord_procs; r++) {
+			memcpy(best[r], coord_shm->slot[r].best, sizeof(best[r]));
+			memcpy(avg[r], coord_shm->slot[r].avg, sizeof(avg[r]));
+		}
+	}
+
+	printf("Coordinated run: %d processes, Best Rate MB/s per process\n", coord_procs);
+	printf("%-10s %12s %12s %12s %12s\n", "Process", "Copy", "Scale", "Add", "Triad");
+	for (r = 0; r < coord_procs; r++) {
+		printf("%-10d", r);
+		for (j = 0; j < 4; j++)
+			printf(" %12.1f", best[r][j]);
+		printf("\n");
+	}
+	printf("%-10s", "Sum best");
+	for (j = 0; j < 4; j++) {
+		for (sum = 0, r = 0; r < coord_procs; r++)
+			sum += best[r][j];
+		printf(" %12.1f", sum);
+		snprintf(key, sizeof(key), "aggregate:%s:best_mbs", kernel_table[j].name);
+		report_meta(key, 1, "%.1f", sum);
+	}
+	printf("\n%-10s", "Sum avg");
+	for (j = 0; j < 4; j++) {
+		for (sum = 0, r = 0; r < coord_procs; r++)
+			sum += avg[r][j];
+		printf(" %12.1f", sum);
+		snprintf(key, sizeof(key), "aggregate:%s:avg_mbs", kernel_table[j].name);
+		report_meta(key, 1, "%.1f", sum);
+	}
+	printf("\n%-10s", "Min/max");
+	for (j = 0; j < 4; j++) {
+		lo = hi = best[0][j];
+		for (r = 1; r < coord_procs; r++) {
+			lo = MIN(lo, best[r][j]);
+			hi = MAX(hi, best[r][j]);
+		}
+		printf(" %12.3f", lo / hi);
+	}
+	/* Jain's index: 1 when every process gets the same share, 1/N when one gets it all */
+	printf("\n%-10s", "Fairness");
+	for (j = 0; j < 4; j++) {
+		for (sum = sumsq = 0, r = 0; r < coord_procs; r++) {
+			sum += best[r][j];
+			sumsq += best[r][j] * best[r][j];
+		}
+		printf(" %12.3f", sum * sum / (coord_procs * sumsq));
+		snprintf(key, sizeof(key), "aggregate:%s:fairness", kernel_table[j].name);
+		report_meta(key, 1, "%.4f", sum * sum / (coord_procs * sumsq));
+	}
+	printf("\n");
+	printf(HLINE);
+}
+
+static void coord_close(void)
+{
+	int r;
+
+	if (coord_procs <= 1)
+		return;		/* coord_open() never ran, coord_fd[] is not set up */
+	if (coord_shm) {
+		if (coord_rank == 0)
+			__atomic_store_n(&coord_shm->session, 0, __ATOMIC_RELEASE);
+		munmap(coord_shm, coord_ctrl_bytes());
+		coord_shm = NULL;
+	}
+	for (r = 0; r < COORD_MAX; r++)
+		if (coord_fd[r] >= 0) {
+			close(coord_fd[r]);
+			coord_fd[r] = -1;
+		}
+}
+
+/*
+ * Software prefetch hints.  On RISC-V these are the Zicbop prefetch.r and
+ * prefetch.w instructions (ori x0 encodings, so they are plain no-ops on
+ * cores without the extension and need no probe); elsewhere the compiler
+ * builtin.
+ */
+#if defined(__riscv)
+#define PREFETCH_R(p)	__asm__ __volatile__ (".insn i 0x13, 6, x0, %0, 1" : : "r"(p))
+#define PREFETCH_W(p)	__asm__ __volatile__ (".insn i 0x13, 6, x0, %0, 3" : : "r"(p))
+#else
+#define PREFETCH_R(p)	__builtin_prefetch((p), 0, 3)
+#define PREFETCH_W(p)	__builtin_prefetch((p), 1, 3)
+#endif
+
+/*
+ * Element-type and unroll variants (--types, --unroll).  The same a, b,
+ * c buffers are reinterpreted as float, double, uint32, uint64 or a
+ * 128-bit vector of two uint64 and the four kernels are run over them
+ * from a macro-generated family, unrolled 1, 2, 4 or 8 elements deep;
+ * with --prefetch-dist each unrolled step also prefetches its source
+ * streams that many bytes ahead.  Integer variants wrap, so they are
+ * validated exactly; the floating point ones against an epsilon for
+ * their width.
+ */
+typedef uint64_t	v128_t __attribute__((vector_size(16)));
+
+struct variant_ops {
+	const char	*type;
+	int		elem, unroll;
+	void		(*kernel[4])(void *a, void *b, void *c, ssize_t n, ssize_t pf);
+	void		(*init)(void *a, void *b, void *c, ssize_t n);
+	ssize_t		(*check)(const void *a, const void *b, const void *c, ssize_t n, int iters);
+};
+
+#define VARIANT_LOOP(T, U, DST, EXPR, PF) \
+	_Pragma("omp parallel") \
+	{ \
+		ssize_t lo, hi, j, u; \
+		thread_range(n, &lo, &hi); \
+		for (j = lo; j + U <= hi; j += U) { \
+			if (pf) { PF; } \
+			for (u = 0; u < U; u++) \
+				DST[j + u] = EXPR(j + u); \
+		} \
+		for (; j < hi; j++) \
+			DST[j] = EXPR(j); \
+	}
+
+#define VARIANT_KERNELS(T, NAME, U) \
+static void NAME##_copy_u##U(void *va, void *vb, void *vc, ssize_t n, ssize_t pf) \
+{ \
+	T *restrict a_ = va, *restrict c_ = vc; \
+	(void) vb; \
+	VARIANT_LOOP(T, U, c_, VAR_COPY, PREFETCH_R(&a_[j + pf])) \
+} \
+static void NAME##_scale_u##U(void *va, void *vb, void *vc, ssize_t n, ssize_t pf) \
+{ \
+	T *restrict b_ = vb, *restrict c_ = vc, s_ = VAR_SCALAR(T); \
+	(void) va; \
+	VARIANT_LOOP(T, U, b_, VAR_SCALE, PREFETCH_R(&c_[j + pf])) \
+} \
+static void NAME##_add_u##U(void *va, void *vb, void *vc, ssize_t n, ssize_t pf) \
+{ \
+	T *restrict a_ = va, *restrict b_ = vb, *restrict c_ = vc; \
+	VARIANT_LOOP(T, U, c_, VAR_ADD, PREFETCH_R(&a_[j + pf]); \
+	    PREFETCH_R(&b_[j + pf])) \
+} \
+static void NAME##_triad_u##U(void *va, void *vb, void *vc, ssize_t n, ssize_t pf) \
+{ \
+	T *restrict a_ = va, *restrict b_ = vb, *restrict c_ = vc, s_ = VAR_SCALAR(T); \
+	VARIANT_LOOP(T, U, a_, VAR_TRIAD, PREFETCH_R(&b_[j + pf]); \
+	    PREFETCH_R(&c_[j + pf])) \
+}
+
+#define VAR_COPY(j)		a_[j]
+#define VAR_SCALE(j)		(s_ * c_[j])
+#define VAR_ADD(j)		(a_[j] + b_[j])
+#define VAR_TRIAD(j)		(b_[j] + s_ * c_[j])
+#define VAR_SCALAR(T)		((T) {0} + 3)
+
+/* a = 1, b = 2, c = 0 in T; check replays the iterations in T itself and counts the misses */
+#define VARIANT_CHECK(T, NAME, BAD) \
+static void NAME##_init(void *va, void *vb, void *vc, ssize_t n) \
+{ \
+	T *a_ = va, *b_ = vb, *c_ = vc; \
+	ssize_t j; \
+	_Pragma("omp parallel for") \
+	for (j = 0; j < n; j++) { \
+		a_[j] = (T) {0} + 1; \
+		b_[j] = (T) {0} + 2; \
+		c_[j] = (T) {0}; \
+	} \
+} \
+static ssize_t NAME##_check(const void *va, const void *vb, const void *vc, ssize_t n, int iters) \
+{ \
+	const T *a_ = va, *b_ = vb, *c_ = vc; \
+	T aj = (T) {0} + 1, bj = (T) {0} + 2, cj = (T) {0}, s_ = VAR_SCALAR(T); \
+	ssize_t j, bad = 0; \
+	int k; \
+	for (k = 0; k < iters; k++) { \
+		cj = aj; \
+		bj = s_ * cj; \
+		cj = aj + bj; \
+		aj = bj + s_ * cj; \
+	} \
+	_Pragma("omp parallel for reduction(+:bad)") \
+	for (j = 0; j < n; j++) \
+		bad += BAD(a_[j], aj) + BAD(b_[j], bj) + BAD(c_[j], cj); \
+	return bad; \
+}
+
+#define VAR_BAD_EXACT(x, y)	((x) != (y))
+/* written as !(err <= eps) so inf and NaN results fail */
+#define VAR_BAD_FLOAT(x, y)	(!(fabs((double)(x) - (double)(y)) <= 1.e-6 * fabs((double)(y))))
+#define VAR_BAD_DOUBLE(x, y)	(!(fabs((x) - (y)) <= 1.e-13 * fabs(y)))
+#define VAR_BAD_V128(x, y)	((x)[0] != (y)[0] || (x)[1] != (y)[1])
+
+#define VARIANT_TYPE(T, NAME, BAD) \
+VARIANT_KERNELS(T, NAME, 1) \
+VARIANT_KERNELS(T, NAME, 2) \
+VARIANT_KERNELS(T, NAME, 4) \
+VARIANT_KERNELS(T, NAME, 8) \
+VARIANT_CHECK(T, NAME, BAD)
+
+VARIANT_TYPE(float, var_float, VAR_BAD_FLOAT)
+VARIANT_TYPE(double, var_double, VAR_BAD_DOUBLE)
+VARIANT_TYPE(uint32_t, var_int32, VAR_BAD_EXACT)
+VARIANT_TYPE(uint64_t, var_int64, VAR_BAD_EXACT)
+VARIANT_TYPE(v128_t, var_v128, VAR_BAD_V128)
+
+#define VARIANT_OPS(TYPE, T, NAME, U) \
+	{TYPE, sizeof(T), U, {NAME##_copy_u##U, NAME##_scale_u##U, NAME##_add_u##U, NAME##_triad_u##U}, \
+	 NAME##_init, NAME##_check}
+#define VARIANT_OPS_TYPE(TYPE, T, NAME) \
+	VARIANT_OPS(TYPE, T, NAME, 1), VARIANT_OPS(TYPE, T, NAME, 2), \
+	VARIANT_OPS(TYPE, T, NAME, 4), VARIANT_OPS(TYPE, T, NAME, 8)
+
+static const struct variant_ops	variant_ops[] = {
+	VARIANT_OPS_TYPE("float", float, var_float),
+	VARIANT_OPS_TYPE("double", double, var_double),
+	VARIANT_OPS_TYPE("int32", uint32_t, var_int32),
+	VARIANT_OPS_TYPE("int64", uint64_t, var_int64),
+	VARIANT_OPS_TYPE("v128", v128_t, var_v128),
+};
+#define NVARIANT_OPS	(int)(sizeof(variant_ops) / sizeof(variant_ops[0]))
+
+/* --types=float,double,int32,int64,v128 (or all) */
+static int parse_variant_types(const char *arg)
+{
+	static const char *names[5] = {"float", "double", "int32", "int64", "v128"};
+	char buf[128], *tok, *save;
+	int i;
+
+	variant_types = 0;
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (strcmp(tok, "all") == 0) {
+			variant_types = 0x1f;
+			continue;
+		}
+		for (i = 0; i < 5; i++)
+			if (strcmp(tok, names[i]) == 0)
+				break;
+		if (i == 5)
+			return -1;
+		variant_types |= 1 << i;
+	}
+	return variant_types ? 0 : -1;
+}
+
+/* --unroll=1,2,4,8 */
+static int parse_variant_unrolls(const char *arg)
+{
+	char *p = (char *) arg;
+	long u;
+
+	variant_unrolls = 0;
+	while (*p) {
+		u = strtol(p, &p, 10);
+		if (u != 1 && u != 2 && u != 4 && u != 8)
+			return -1;
+		variant_unrolls |= u;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return variant_unrolls ? 0 : -1;
+}
+
+static void run_variants(ssize_t buffer_size)
+{
+	static const double var_words[4] = {2, 2, 3, 3};
+	double *times[NKERNELS], rate[4];
+	const struct variant_ops *v;
+	struct time_stats st;
+	ssize_t n, pf, bad, errors = 0;
+	char group[48];
+	int i, j, k;
+
+	alloc_times(times);
+	printf("Element variants: Best Rate MB/s, prefetch distance %ld bytes%s\n",
+	    (long) variant_prefetch, variant_prefetch ? "" : " (off)");
+	printf("%-14s %12s %12s %12s %12s\n", "Variant", "Copy", "Scale", "Add", "Triad");
+	for (i = 0; i < NVARIANT_OPS; i++) {
+		v = &variant_ops[i];
+		if (!(variant_types & (1 << (i / 4))) || !(variant_unrolls & v->unroll))
+			continue;
+		if (((uintptr_t) a | (uintptr_t) b | (uintptr_t) c) % v->elem) {
+			printf("%s/u%d: arrays not %d-byte aligned, skipped\n", v->type, v->unroll, v->elem);
+			continue;
+		}
+		n = buffer_size / v->elem;
+		pf = (variant_prefetch + v->elem - 1) / v->elem;
+
+		v->init(a, b, c, n);
+		for (k = 0; k < ntimes; k++) {
+			for (j = 0; j < 4; j++) {
+				times[j][k] = mysecond();
+				v->kernel[j](a, b, c, n, pf);
+				times[j][k] = mysecond() - times[j][k];
+			}
+		}
+		snprintf(group, sizeof(group), "variant:%s:u%d", v->type, v->unroll);
+		for (j = 0; j < 4; j++) {
+			double nbytes = var_words[j] * v->elem * (double) n;
+
+			sample_stats(times[j], ntimes, warmup, &st);
+			rate[j] = 1.0E-06 * nbytes / st.min;
+			report_kernel(group, kernel_table[j].name, nbytes, times[j], ntimes);
+		}
+		printf("%-6s u%-7d %12.1f %12.1f %12.1f %12.1f\n", v->type, v->unroll,
+		    rate[0], rate[1], rate[2], rate[3]);
+		bad = v->check(a, b, c, n, ntimes);
+		if (bad) {
+			printf("Failed Validation on %s/u%d: %ld elements wrong\n", v->type, v->unroll, (long) bad);
+			errors++;
+		}
+	}
+	printf(HLINE);
+	if (errors == 0)
+		printf("Solution Validates: all element variants\n");
+	report_validation("variant", errors);
+	printf(HLINE);
+	free_times(times);
+}
+
+/*
+ * Prefetch distance sweep (--prefetch-sweep[=BYTES,...]).  Triad is run
+ * with a[] prefetched for writing and b[], c[] for reading the given
+ * distance ahead of the current cache line, distance 0 being the plain
+ * loop, once with all three arrays local and once with all three in the
+ * mapped region, and the distance with the best rate is reported for
+ * each region.
+ */
+static void prefetch_triad(ssize_t stream_array_size, ssize_t dist, ssize_t line, STREAM_TYPE scalar)
+{
+#pragma omp parallel
+	{
+		ssize_t lo, hi, j, k, end;
+
+		thread_range(stream_array_size, &lo, &hi);
+		for (j = lo; j < hi; j = end) {
+			end = MIN(j + line, hi);
+			if (dist) {
+				PREFETCH_W(&a[j + dist]);
+				PREFETCH_R(&b[j + dist]);
+				PREFETCH_R(&c[j + dist]);
+			}
+			for (k = j; k < end; k++)
+				a[k] = b[k] + scalar * c[k];
+		}
+	}
+}
+
+static int parse_prefetch_sweep(const char *arg)
+{
+	char *p = (char *) arg;
+
+	nprefetch_dists = 0;
+	while (*p && nprefetch_dists < 32) {
+		prefetch_dists[nprefetch_dists] = parse_size(p, &p);
+		if (prefetch_dists[nprefetch_dists++] < 0)
+			return -1;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return (nprefetch_dists > 0) ? 0 : -1;
+}
+
+static void run_prefetch_sweep(ssize_t stream_array_size)
+{
+	static const char *region_place[2] = {"LLL", "RRR"}, *region_name[2] = {"local", "remote"};
+	double *times[NKERNELS], rate[2][32], best[2] = {0, 0};
+	ssize_t line = MAX(cm_line_size() / (ssize_t)sizeof(STREAM_TYPE), 1), best_dist[2] = {0, 0};
+	struct time_stats st;
+	char group[48], key[48];
+	int r, i, k, have[2], errors = 0;
+
+	have[0] = local_array[0] && local_array[1] && local_array[2];
+	have[1] = remote_array[0] && remote_array[1] && remote_array[2];
+	alloc_times(times);
+	printf("Prefetch distance sweep: Triad Best Rate MB/s, %ld-byte lines\n",
+	    (long)(line * sizeof(STREAM_TYPE)));
+	printf("%14s", "Distance");
+	for (r = 0; r < 2; r++)
+		if (have[r])
+			printf(" %12s", region_name[r]);
+	printf("\n");
+	for (r = 0; r < 2; r++) {
+		if (!have[r])
+			continue;
+		set_placement(region_place[r]);
+		init_arrays(stream_array_size);
+		estimate_kernel_time(stream_array_size);
+		for (i = 0; i < nprefetch_dists; i++) {
+			ssize_t dist = prefetch_dists[i] / sizeof(STREAM_TYPE);
+
+			for (k = 0; k < ntimes; k++) {
+				times[3][k] = mysecond();
+				prefetch_triad(stream_array_size, dist, line, 3.0);
+				times[3][k] = mysecond() - times[3][k];
+			}
+			sample_stats(times[3], ntimes, warmup, &st);
+			rate[r][i] = 1.0E-06 * bytes[3] / st.min;
+			if (rate[r][i] > best[r]) {
+				best[r] = rate[r][i];
+				best_dist[r] = prefetch_dists[i];
+			}
+			snprintf(group, sizeof(group), "prefetch:%s:%ld", region_name[r], (long) prefetch_dists[i]);
+			report_kernel(group, kernel_table[3].name, bytes[3], times[3], ntimes);
+		}
+		/* Triad does not change b[] or c[]: a[] = b + 3 c after every pass */
+		errors += check_ac_results(stream_array_size, init_b + 3.0 * init_c, init_c);
+	}
+	for (i = 0; i < nprefetch_dists; i++) {
+		printf("%14ld", (long) prefetch_dists[i]);
+		for (r = 0; r < 2; r++)
+			if (have[r])
+				printf(" %12.1f", rate[r][i]);
+		printf("\n");
+	}
+	for (r = 0; r < 2; r++) {
+		if (!have[r])
+			continue;
+		printf("Best distance %-7s %ld bytes, %.1f MB/s (%+.1f%% over distance %ld)\n",
+		    region_name[r], (long) best_dist[r], best[r],
+		    rate[r][0] > 0 ? 100.0 * (best[r] / rate[r][0] - 1.0) : 0.0, (long) prefetch_dists[0]);
+		snprintf(key, sizeof(key), "prefetch_best:%s", region_name[r]);
+		report_meta(key, 1, "%ld", (long) best_dist[r]);
+	}
+	printf(HLINE);
+	if (errors == 0)
+		printf("Solution Validates: all prefetch distances\n");
+	report_validation("prefetch", errors);
+	printf(HLINE);
+	set_placement(placement);
+	free_times(times);
+}
+
+/*
+ * DMA copy back-end (--dma=BACKEND).  Copy c = a is cut into --dma-chunk
+ * descriptors which are submitted to a DMA engine with up to --dma-depth
+ * of them in flight and retired in order; the table has the throughput
+ * and the submit-to-completion latency of a descriptor for each depth,
+ * next to the CPU Copy loop over the same arrays.  Back-ends:
+ *	thread		a helper thread doing memcpy, the software reference
+ *	ioctl:DEV	a driver shim on DEV with the ABI below; addresses are
+ *			device offsets in the mapped window, so a[] and c[]
+ *			must both be remote
+ * The ioctl ABI is two calls, both returning 0 on success:
+ *	STREAM_DMA_SUBMIT	struct stream_dma_desc in, cookie filled in
+ *	STREAM_DMA_WAIT		blocks until the descriptor with that cookie
+ *				(and all submitted before it) completed
+ */
+struct stream_dma_desc {
+	uint64_t	src, dst, len;
+	uint64_t	cookie;
+};
+#define STREAM_DMA_SUBMIT	_IOWR('S', 1, struct stream_dma_desc)
+#define STREAM_DMA_WAIT		_IOW('S', 2, uint64_t)
+
+#define DMA_RING	256
+struct dma_backend {
+	const char	*name;
+	int		(*open)(const char *arg);
+	int		(*submit)(ssize_t slot, ssize_t off, ssize_t len);	/* off/len in bytes of a[], c[] */
+	int		(*wait)(ssize_t slot);
+	void		(*close)(void);
+};
+
+/* thread: a ring of descriptors drained by one helper thread */
+static struct {
+	char			*src[DMA_RING], *dst[DMA_RING];
+	size_t			len[DMA_RING];
+	volatile uint64_t	head, done;	/* submitted, completed */
+	uint64_t		base;		/* head when slot 0 of this pass went in */
+	volatile int		stop;
+	pthread_t		tid;
+} dma_ring;
+
+static void *dma_thread_main(void *arg)
+{
+	uint64_t n;
+
+	(void) arg;
+	while (!dma_ring.stop) {
+		n = __atomic_load_n(&dma_ring.done, __ATOMIC_RELAXED);
+		if (n == __atomic_load_n(&dma_ring.head, __ATOMIC_ACQUIRE)) {
+			sched_yield();
+			continue;
+		}
+		memcpy(dma_ring.dst[n % DMA_RING], dma_ring.src[n % DMA_RING], dma_ring.len[n % DMA_RING]);
+		__atomic_store_n(&dma_ring.done, n + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static int dma_thread_open(const char *arg)
+{
+	(void) arg;
+	dma_ring.head = dma_ring.done = 0;
+	dma_ring.stop = 0;
+	return pthread_create(&dma_ring.tid, NULL, dma_thread_main, NULL) ? -1 : 0;
+}
+
+static int dma_thread_submit(ssize_t slot, ssize_t off, ssize_t len)
+{
+	uint64_t n = dma_ring.head;
+
+	if (slot == 0)
+		dma_ring.base = n;
+	dma_ring.src[n % DMA_RING] = (char *) a + off;
+	dma_ring.dst[n % DMA_RING] = (char *) c + off;
+	dma_ring.len[n % DMA_RING] = len;
+	__atomic_store_n(&dma_ring.head, n + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static int dma_thread_wait(ssize_t slot)
+{
+	while (__atomic_load_n(&dma_ring.done, __ATOMIC_ACQUIRE) <= dma_ring.base + slot)
+		sched_yield();
+	return 0;
+}
+
+static void dma_thread_close(void)
+{
+	dma_ring.stop = 1;
+	pthread_join(dma_ring.tid, NULL);
+}
+
+/* ioctl:DEV: the driver shim */
+static int		dma_fd = -1;
+static uint64_t		dma_cookie[DMA_RING];
+
+static int dma_ioctl_open(const char *arg)
+{
+	if (remote_offset == 0 || a != remote_array[0] || c != remote_array[2]) {
+		printf("--dma=ioctl needs a[] and c[] remote on a single device (--place=R?R)\n");
+		return -1;
+	}
+	if ((dma_fd = open(arg, O_RDWR)) < 0) {
+		printf("%s is not opened\n", arg);
+		return -1;
+	}
+	return 0;
+}
+
+static int dma_ioctl_submit(ssize_t slot, ssize_t off, ssize_t len)
+{
+	struct stream_dma_desc d;
+
+	d.src = remote_offset + 0 * remote_bytes + off;
+	d.dst = remote_offset + 2 * remote_bytes + off;
+	d.len = len;
+	d.cookie = 0;
+	if (ioctl(dma_fd, STREAM_DMA_SUBMIT, &d) != 0)
+		return -1;
+	dma_cookie[slot % DMA_RING] = d.cookie;
+	return 0;
+}
+
+static int dma_ioctl_wait(ssize_t slot)
+{
+	return ioctl(dma_fd, STREAM_DMA_WAIT, &dma_cookie[slot % DMA_RING]);
+}
+
+static void dma_ioctl_close(void)
+{
+	close(dma_fd);
+	dma_fd = -1;
+}
+
+static const struct dma_backend	dma_backends[] = {
+	{"thread", dma_thread_open, dma_thread_submit, dma_thread_wait, dma_thread_close},
+	{"ioctl", dma_ioctl_open, dma_ioctl_submit, dma_ioctl_wait, dma_ioctl_close},
+};
+
+static int parse_dma_depths(const char *arg)
+{
+	char *p = (char *) arg;
+
+	ndma_depths = 0;
+	while (*p && ndma_depths < 16) {
+		dma_depths[ndma_depths] = strtol(p, &p, 10);
+		if (dma_depths[ndma_depths] < 1 || dma_depths[ndma_depths] > DMA_RING)
+			return -1;
+		ndma_depths++;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return (ndma_depths > 0) ? 0 : -1;
+}
+
+/* one pass of c = a through the engine; latency[] gets one sample per descriptor */
+static double dma_pass(const struct dma_backend *be, ssize_t nbytes, int depth, double *latency)
+{
+	ssize_t chunk = MIN(dma_chunk, nbytes), nchunks = (nbytes + chunk - 1) / chunk, next = 0, old = 0;
+	double *submit_time = malloc(nchunks * sizeof(double)), t;
+
+	t = mysecond();
+	while (old < nchunks) {
+		while (next < nchunks && next - old < depth) {
+			submit_time[next] = mysecond();
+			if (be->submit(next, next * chunk, MIN(chunk, nbytes - next * chunk)) != 0) {
+				printf("DMA submit failed: %s\n", strerror(errno));
+				free(submit_time);
+				return -1;
+			}
+			next++;
+		}
+		if (be->wait(old) != 0) {
+			printf("DMA wait failed: %s\n", strerror(errno));
+			free(submit_time);
+			return -1;
+		}
+		latency[old] = mysecond() - submit_time[old];
+		old++;
+	}
+	t = mysecond() - t;
+	free(submit_time);
+	return t;
+}
+
+static void run_dma(ssize_t stream_array_size)
+{
+	const struct dma_backend *be = NULL;
+	double *times[NKERNELS], *latency, cpu_rate, nbytes = bytes[0];
+	ssize_t nchunks = (stream_array_size * sizeof(STREAM_TYPE) + dma_chunk - 1) / dma_chunk, j;
+	STREAM_TYPE fill;
+	struct time_stats st, lst;
+	char group[48];
+	int i, k, d, errors = 0;
+	const char *arg = strchr(dma_mode, ':');
+	size_t len = arg ? (size_t)(arg - dma_mode) : strlen(dma_mode);
+
+	for (i = 0; i < (int)(sizeof(dma_backends) / sizeof(dma_backends[0])); i++)
+		if (strlen(dma_backends[i].name) == len && strncmp(dma_mode, dma_backends[i].name, len) == 0)
+			be = &dma_backends[i];
+	if (be == NULL) {
+		printf("Unknown --dma=%s, expected thread or ioctl:DEV\n", dma_mode);
+		return;
+	}
+	if (be->open(arg ? arg + 1 : NULL) != 0)
+		return;
+	alloc_times(times);
+	latency = malloc((ntimes - warmup) * nchunks * sizeof(double));
+
+	init_arrays(stream_array_size);
+	for (k = 0; k < ntimes; k++) {
+		times[0][k] = mysecond();
+		kernel_copy(stream_array_size, 3.0);
+		times[0][k] = mysecond() - times[0][k];
+	}
+	sample_stats(times[0], ntimes, warmup, &st);
+	cpu_rate = 1.0E-06 * nbytes / st.min;
+	report_kernel("dma:cpu", kernel_table[0].name, nbytes, times[0], ntimes);
+
+	printf("DMA Copy (c = a) via %s, %ld-byte descriptors, %ld per pass\n", dma_mode,
+	    (long) dma_chunk, (long) nchunks);
+	printf("%-10s %8s %12s %9s %12s %12s %12s\n", "Engine", "Depth", "Copy MB/s", "vs CPU",
+	    "Lat avg us", "Lat p50 us", "Lat p99 us");
+	printf("%-10s %8s %12.1f %8.1f%% %12s %12s %12s\n", "cpu", "-", cpu_rate, 100.0, "-", "-", "-");
+	for (d = 0; d < ndma_depths; d++) {
+		/*
+		 * c[] != a[] before each depth, so a lost descriptor shows up;
+		 * --init=reuse would otherwise keep the c = a of the last pass
+		 */
+		init_arrays(stream_array_size);
+		fill = (init_a == 0) ? 1.0 : 0.0;
+#pragma omp parallel for
+		for (j = 0; j < stream_array_size; j++)
+			c[j] = fill;
+		for (k = 0; k < ntimes; k++) {
+			times[0][k] = dma_pass(be, stream_array_size * sizeof(STREAM_TYPE), dma_depths[d],
+			    latency + (k >= warmup ? (k - warmup) * nchunks : 0));
+			if (times[0][k] < 0)
+				goto out;
+		}
+		sample_stats(times[0], ntimes, warmup, &st);
+		sample_stats(latency, (ntimes - warmup) * nchunks, 0, &lst);
+		printf("%-10s %8d %12.1f %8.1f%% %12.2f %12.2f %12.2f\n", be->name, dma_depths[d],
+		    1.0E-06 * nbytes / st.min, 100.0 * (1.0E-06 * nbytes / st.min) / cpu_rate,
+		    1.0E6 * lst.avg, 1.0E6 * lst.pct[0], 1.0E6 * lst.pct[2]);
+		snprintf(group, sizeof(group), "dma:%s:%d", be->name, dma_depths[d]);
+		report_kernel(group, kernel_table[0].name, nbytes, times[0], ntimes);
+		snprintf(group, sizeof(group), "dma:%s:%d:latency_us", be->name, dma_depths[d]);
+		report_meta(group, 1, "%.3f", 1.0E6 * lst.avg);
+		errors += check_ac_results(stream_array_size, init_a, init_a);
+	}
+	printf(HLINE);
+	if (errors == 0)
+		printf("Solution Validates: c[] == a[] after every DMA depth\n");
+	report_validation("dma", errors);
+	printf(HLINE);
+out:
+	be->close();
+	free(latency);
+	free_times(times);
+}
+
+/*
+ * Bandwidth-over-time trace (--trace=K).  The main run uses chunked
+ * copies of the kernels instead of kernel_table[].body: every thread
+ * walks its static share K cache lines at a time and stores a timestamp
+ * after each chunk in its own preallocated buffer, so the hot path has
+ * no printf and no shared writes.  After the run each chunk becomes one
+ * row of thread, kernel, iteration, start, end and instantaneous MB/s
+ * (to --trace-file or stdout), and the per-kernel spread of the chunk
+ * rates is printed, which shows throttling, refresh stalls and credit
+ * starvation that one duration per iteration averages away.  The chunked
+ * loops are plain C even with TUNED.
+ */
+struct trace_point {
+	double		t;		/* end of the chunk */
+	double		bytes;		/* moved by it, 0 marks the start of a pass */
+	int		kernel, iter;
+};
+struct trace_buf {
+	struct trace_point	*p;
+	ssize_t			n, cap;
+};
+static struct trace_buf	*trace_bufs = NULL;
+static int		trace_nthreads = 1;
+static ssize_t		trace_step = 0;		/* elements per chunk */
+
+static int trace_init(ssize_t stream_array_size)
+{
+	ssize_t line = MAX(cm_line_size() / (ssize_t)sizeof(STREAM_TYPE), 1), share;
+	int t;
+
+#ifdef _OPENMP
+	trace_nthreads = omp_get_max_threads();
+#endif
+	trace_step = trace_lines * line;
+	share = (stream_array_size + trace_nthreads - 1) / trace_nthreads;
+	trace_bufs = calloc(trace_nthreads, sizeof(struct trace_buf));
+	if (trace_bufs == NULL)
+		return -1;
+	for (t = 0; t < trace_nthreads; t++) {
+		trace_bufs[t].cap = (ssize_t) ntimes * nkernels * ((share + trace_step - 1) / trace_step + 2);
+		trace_bufs[t].p = malloc(trace_bufs[t].cap * sizeof(struct trace_point));
+		if (trace_bufs[t].p == NULL) {
+			printf("Cannot allocate %ld trace points\n", (long) trace_bufs[t].cap);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static inline void trace_mark(struct trace_buf *tb, int kernel, int iter, double nbytes)
+{
+	struct trace_point *p;
+
+	if (tb->n == tb->cap)
+		return;
+	p = &tb->p[tb->n++];
+	p->t = mysecond();
+	p->bytes = nbytes;
+	p->kernel = kernel;
+	p->iter = iter;
+}
+
+static void trace_kernel(int kernel, ssize_t stream_array_size, STREAM_TYPE scalar, int iter)
+{
+	ssize_t mline = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1), group = rw_read + rw_write;
+	double per = kernel_table[kernel].nbytes(stream_array_size) / stream_array_size;
+	STREAM_TYPE total = 0;
+
+#pragma omp parallel
+	{
+		struct trace_buf *tb;
+		ssize_t lo, hi, j, k, end, e;
+		STREAM_TYPE sum = 0;
+		int t = 0;
+
+		THREAD_NUM(t);
+		tb = &trace_bufs[t];
+		thread_range(stream_array_size, &lo, &hi);
+		trace_mark(tb, kernel, iter, 0);
+		for (j = lo; j < hi; j = end) {
+			end = MIN(j + trace_step, hi);
+			switch (kernel) {
+			case 0: for (k = j; k < end; k++) c[k] = a[k]; break;
+			case 1: for (k = j; k < end; k++) b[k] = scalar * c[k]; break;
+			case 2: for (k = j; k < end; k++) c[k] = a[k] + b[k]; break;
+			case 3: for (k = j; k < end; k++) a[k] = b[k] + scalar * c[k]; break;
+			case 4: for (k = j; k < end; k++) sum += a[k]; break;
+			case 5: for (k = j; k < end; k++) c[k] = write_value; break;
+			case 6:	/* same line grouping as kernel_mix() */
+				for (k = j; k < end; k = e) {
+					e = MIN((k / mline + 1) * mline, end);
+					if ((k / mline) % group < rw_read)
+						for (; k < e; k++) sum += a[k];
+					else
+						for (; k < e; k++) c[k] = write_value;
+				}
+				break;
+			}
+			trace_mark(tb, kernel, iter, (end - j) * per);
+		}
+#pragma omp atomic
+		total += sum;
+	}
+	if (kernel == 4)
+		read_sum = total;
+	else if (kernel == 6)
+		mix_sum = total;
+}
+
+/* every chunk to trace_path (or stdout), then the chunk-rate spread per kernel */
+static void trace_dump(void)
+{
+	FILE *fp = stdout;
+	double *rates[NKERNELS], t0 = FLT_MAX, start = 0, rate;
+	ssize_t nrates[NKERNELS] = {0}, total = 0, rows = 0, slow, i;
+	struct time_stats st;
+	int t, s, j, dropped = 0;
+
+	for (t = 0; t < trace_nthreads; t++) {
+		total += trace_bufs[t].n;
+		dropped |= (trace_bufs[t].n == trace_bufs[t].cap);
+		if (trace_bufs[t].n > 0)
+			t0 = MIN(t0, trace_bufs[t].p[0].t);
+	}
+	for (j = 0; j < NKERNELS; j++)
+		rates[j] = malloc(total * sizeof(double));
+	if (trace_path && (fp = fopen(trace_path, "w")) == NULL) {
+		printf("Cannot open trace file %s: %s, writing to stdout\n", trace_path, strerror(errno));
+		fp = stdout;
+	}
+	fprintf(fp, "thread,kernel,iter,start_s,end_s,bytes,MBps\n");
+	for (t = 0; t < trace_nthreads; t++) {
+		for (i = 0; i < trace_bufs[t].n; i++) {
+			struct trace_point *p = &trace_bufs[t].p[i];
+
+			if (p->bytes == 0) {
+				start = p->t;
+				continue;
+			}
+			rate = (p->t > start) ? 1.0E-06 * p->bytes / (p->t - start) : 0.0;
+			fprintf(fp, "%d,%s,%d,%.9f,%.9f,%.0f,%.1f\n", t, kernel_table[p->kernel].name, p->iter,
+			    start - t0, p->t - t0, p->bytes, rate);
+			rows++;
+			if (p->iter >= warmup && rate > 0)
+				rates[p->kernel][nrates[p->kernel]++] = rate;
+			start = p->t;
+		}
+	}
+	if (fp != stdout) {
+		fclose(fp);
+		printf("Trace: %ld chunks written to %s\n", (long) rows, trace_path);
+	}
+	if (dropped)
+		printf("Trace buffer full, later chunks were not recorded\n");
+
+	printf("Trace: per-thread chunk rates, %ld-line chunks, MB/s\n", (long) trace_lines);
+	printf("Function    Chunks          Min       Median          Max  <50%% median\n");
+	for (s = 0; s < kernels_run; s++) {
+		j = kernel_ran[s];
+		sample_stats(rates[j], nrates[j], 0, &st);
+		if (st.n == 0)
+			continue;
+		for (i = 0, slow = 0; i < nrates[j]; i++)
+			slow += (rates[j][i] < 0.5 * st.pct[0]);
+		printf("%s%6ld  %11.1f  %11.1f  %11.1f  %ld\n", kernel_table[j].label, (long) nrates[j],
+		    st.min, st.pct[0], st.max, (long) slow);
+	}
+	printf(HLINE);
+	report_meta("trace_lines", 1, "%ld", (long) trace_lines);
+	report_meta("trace_chunks", 1, "%ld", (long) rows);
+	for (j = 0; j < NKERNELS; j++)
+		free(rates[j]);
+	for (t = 0; t < trace_nthreads; t++)
+		free(trace_bufs[t].p);
+	free(trace_bufs);
+	trace_bufs = NULL;
+}
+
+/*
+ * Memory-integrity patterns (--integrity[=LIST]).  The STREAM values are
+ * the same in every element, so an address translation that aliases two
+ * lines of the window still validates; these patterns make every 64-bit
+ * word distinct or exercise every bit:
+ *	address		the word's own device offset (or virtual address for
+ *			local arrays), so an aliased line reads back the
+ *			address of its twin
+ *	walk1, walk0	a single 1 (0) bit walking through the word with the
+ *			word index, shifted by one each iteration
+ *	random[:SEED]	a hash of the word index and SEED
+ * Odd iterations store the complement of address and random, so every
+ * bit cell is written both ways.  Each iteration is one parallel write
+ * pass and one parallel verify pass over a[], b[] and c[], timed
+ * separately; failing words are reported as device offsets and relative
+ * to the start of the window, with the OR of all bits that differed.
+ */
+#define INTEGRITY_ADDRESS	0
+#define INTEGRITY_WALK1		1
+#define INTEGRITY_WALK0		2
+#define INTEGRITY_RANDOM	3
+#define INTEGRITY_FAILS		32	/* failing words kept for the report */
+
+struct integrity_fail {
+	int		array, iter;
+	ssize_t		word;
+	uint64_t	expected, observed;
+};
+static struct integrity_fail	integrity_fails[INTEGRITY_FAILS];
+static ssize_t			integrity_nfail;
+static const char		*integrity_name[4] = {"address", "walk1", "walk0", "random"};
+
+static int parse_integrity(const char *arg)
+{
+	char buf[128], *tok, *save, *seed;
+	int i;
+
+	integrity_mode = 0;
+	snprintf(buf, sizeof(buf), "%s", arg);
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (strcmp(tok, "all") == 0) {
+			integrity_mode = 0xf;
+			continue;
+		}
+		if ((seed = strchr(tok, ':')) != NULL) {
+			*seed++ = '\0';
+			if (strcmp(tok, "random") != 0 || *seed == '\0')
+				return -1;
+			integrity_seed = strtoull(seed, NULL, 0);
+		}
+		for (i = 0; i < 4; i++)
+			if (strcmp(tok, integrity_name[i]) == 0)
+				break;
+		if (i == 4)
+			return -1;
+		integrity_mode |= 1 << i;
+	}
+	return integrity_mode ? 0 : -1;
+}
+
+/* splitmix64 finalizer: a stateless hash so every thread can start anywhere */
+static inline uint64_t mix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+static inline uint64_t integrity_word(int pattern, uint64_t base, ssize_t k, int iter)
+{
+	uint64_t flip = (iter & 1) ? ~0ull : 0;
+
+	switch (pattern) {
+	case INTEGRITY_ADDRESS:	return (base + 8 * (uint64_t) k) ^ flip;
+	case INTEGRITY_WALK1:	return 1ull << ((k + iter) & 63);
+	case INTEGRITY_WALK0:	return ~(1ull << ((k + iter) & 63));
+	default:		return mix64(integrity_seed ^ (uint64_t) k) ^ flip;
+	}
+}
+
+/* base of the address pattern and of the report for array i */
+static uint64_t integrity_base(int i, const STREAM_TYPE *x, int *device)
+{
+	*device = (x == remote_array[i]) && nstripe == 0;
+	return *device ? (uint64_t)(remote_offset + i * remote_bytes) : (uint64_t)(uintptr_t) x;
+}
+
+static void integrity_fill(int pattern, uint64_t *w, uint64_t base, ssize_t nwords, int iter)
+{
+	ssize_t k;
+
+#pragma omp parallel for
+	for (k = 0; k < nwords; k++)
+		w[k] = integrity_word(pattern, base, k, iter);
+}
+
+static ssize_t integrity_verify(int pattern, int array, const uint64_t *w, uint64_t base,
+    ssize_t nwords, int iter, uint64_t *bits)
+{
+	ssize_t k, slot, bad = 0;
+	uint64_t diff = 0;
+
+#pragma omp parallel for reduction(+:bad) reduction(|:diff) private(slot)
+	for (k = 0; k < nwords; k++) {
+		uint64_t expected = integrity_word(pattern, base, k, iter), observed = w[k];
+
+		if (observed != expected) {
+			bad++;
+			diff |= observed ^ expected;
+#pragma omp atomic capture
+			slot = integrity_nfail++;
+			if (slot < INTEGRITY_FAILS) {
+				integrity_fails[slot].array = array;
+				integrity_fails[slot].iter = iter;
+				integrity_fails[slot].word = k;
+				integrity_fails[slot].expected = expected;
+				integrity_fails[slot].observed = observed;
+			}
+		}
+	}
+	*bits |= diff;
+	return bad;
+}
+
+static int cmp_integrity_fail(const void *x, const void *y)
+{
+	const struct integrity_fail *fx = x, *fy = y;
+
+	if (fx->array != fy->array)
+		return fx->array - fy->array;
+	if (fx->word != fy->word)
+		return (fx->word > fy->word) - (fx->word < fy->word);
+	return fx->iter - fy->iter;
+}
+
+static void run_integrity(ssize_t stream_array_size)
+{
+	static const char *array_name[3] = {"a", "b", "c"};
+	STREAM_TYPE *x[3] = {a, b, c};
+	uint64_t *w[3] = {(uint64_t *) a, (uint64_t *) b, (uint64_t *) c}, base[3], bits;
+	ssize_t nwords = stream_array_size * sizeof(STREAM_TYPE) / sizeof(uint64_t), errors, total = 0, f;
+	double *wtimes, *vtimes, nbytes = 3.0 * nwords * sizeof(uint64_t), t;
+	int device[3], pattern, i, k;
+	struct time_stats ws, vs;
+	char group[48];
+
+	for (i = 0; i < 3; i++)
+		base[i] = integrity_base(i, x[i], &device[i]);
+	wtimes = calloc(ntimes, sizeof(double));
+	vtimes = calloc(ntimes, sizeof(double));
+	printf("Integrity patterns over a[], b[], c[]: %ld words per array, %d iterations\n",
+	    (long) nwords, ntimes);
+	if (device[0] || device[1] || device[2])
+		printf("Failing words are given as device offsets and relative to offset 0x%lx\n",
+		    (unsigned long) remote_offset);
+	printf("Pattern      Write MB/s   Verify MB/s Miscompares  Bits differing\n");
+	for (pattern = 0; pattern < 4; pattern++) {
+		if (!(integrity_mode & (1 << pattern)))
+			continue;
+		errors = 0;
+		bits = 0;
+		integrity_nfail = 0;
+		for (k = 0; k < ntimes; k++) {
+			t = mysecond();
+			for (i = 0; i < 3; i++)
+				integrity_fill(pattern, w[i], base[i], nwords, k);
+			wtimes[k] = mysecond() - t;
+			t = mysecond();
+			for (i = 0; i < 3; i++)
+				errors += integrity_verify(pattern, i, w[i], base[i], nwords, k, &bits);
+			vtimes[k] = mysecond() - t;
+		}
+		sample_stats(wtimes, ntimes, ntimes > 1 ? warmup : 0, &ws);
+		sample_stats(vtimes, ntimes, ntimes > 1 ? warmup : 0, &vs);
+		printf("%-10s %12.1f  %12.1f  %10ld  0x%016llx\n", integrity_name[pattern],
+		    1.0E-06 * nbytes / ws.min, 1.0E-06 * nbytes / vs.min, (long) errors,
+		    (unsigned long long) bits);
+		qsort(integrity_fails, MIN(integrity_nfail, INTEGRITY_FAILS), sizeof(struct integrity_fail),
+		    cmp_integrity_fail);
+		for (f = 0; f < MIN(integrity_nfail, INTEGRITY_FAILS); f++) {
+			struct integrity_fail *p = &integrity_fails[f];
+			uint64_t at = 8 * (uint64_t) p->word;
+
+			if (device[p->array])
+				printf("     %s[] device 0x%012llx (offset+0x%llx) iter %d: expected 0x%016llx, read 0x%016llx\n",
+				    array_name[p->array], (unsigned long long)(base[p->array] + at),
+				    (unsigned long long)(base[p->array] + at - remote_offset), p->iter,
+				    (unsigned long long) p->expected, (unsigned long long) p->observed);
+			else
+				printf("     %s[] array offset 0x%llx iter %d: expected 0x%016llx, read 0x%016llx\n",
+				    array_name[p->array], (unsigned long long) at, p->iter,
+				    (unsigned long long) p->expected, (unsigned long long) p->observed);
+		}
+		if (integrity_nfail > INTEGRITY_FAILS)
+			printf("     ... %ld more\n", (long)(integrity_nfail - INTEGRITY_FAILS));
+		snprintf(group, sizeof(group), "integrity:%s", integrity_name[pattern]);
+		report_kernel(group, "Write", nbytes, wtimes, ntimes);
+		report_kernel(group, "Verify", nbytes, vtimes, ntimes);
+		report_validation(group, errors);
+		total += errors;
+	}
+	printf(HLINE);
+	if (total == 0)
+		printf("Integrity patterns pass\n");
+	else {
+		printf("Integrity patterns FAILED: %ld miscompares\n", (long) total);
+		exit_status = 1;
+	}
+	printf(HLINE);
+	free(wtimes);
+	free(vtimes);
+}
+
+/*
+ * Loaded latency: OpenMP thread 0 chases a chain over all of a[] while
+ * the other threads run a Triad-type kernel, c = b + 0.5*c (two read
+ * streams, one write stream; the 0.5 keeps the values bounded), over
+ * b[] and c[].  After every LL_BLOCK elements a load thread spins for
+ * "delay" iterations, so stepping through ll_delays[] traces the
+ * latency-vs-bandwidth curve from idle to full injection rate.
+ */
+#define LL_BLOCK	512	/* elements between throttle points */
+
+static long	ll_delays[32] = {100000, 50000, 20000, 10000, 5000, 2000, 1000, 500, 200, 100, 50, 0};
+static int	ll_ndelays = 12;
+
+static int parse_delays(const char *arg)
+{
+	char *p = (char *) arg;
+
+	ll_ndelays = 0;
+	while (*p && ll_ndelays < 32) {
+		ll_delays[ll_ndelays++] = strtol(p, &p, 0);
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+	return (ll_ndelays > 0) ? 0 : -1;
+}
+
+static void run_loaded_latency(ssize_t stream_array_size, ssize_t buffer_size)
+{
+#ifdef _OPENMP
+	double *samples, elapsed = 0, total_bytes;
+	struct time_stats st;
+	volatile int stop, counting;
+	ssize_t j;
+	char group[32];
+	void **head;
+	int d, nthreads = 1;
+
+#pragma omp parallel
+#pragma omp master
+	nthreads = omp_get_num_threads();
+	if (nthreads < 2) {
+		printf("Loaded latency needs at least 2 OpenMP threads (OMP_NUM_THREADS)\n");
+		return;
+	}
+	if (lat_stride > buffer_size) {
+		printf("Invalid --lat-stride=%ld, larger than the array\n", (long) lat_stride);
+		return;
+	}
+
+	samples = malloc(ntimes * sizeof(double));
+	head = build_chain((char *) a, buffer_size / lat_stride * lat_stride, lat_stride, lat_page);
+#pragma omp parallel for
+	for (j = 0; j < stream_array_size; j++) {
+		b[j] = 2.0;
+		c[j] = 0.0;
+	}
+
+	printf("Loaded latency: thread 0 chases a[] (%s, %ld bytes), %d threads run c = b + 0.5*c\n",
+	    placement[0] == PLACE_REMOTE ? "remote" : "local", (long) buffer_size, nthreads - 1);
+	printf("%10s %16s %16s %16s\n", "Delay", "Bandwidth MB/s", "ns/load median", "ns/load min");
+	for (d = 0; d < ll_ndelays; d++) {
+		long delay = ll_delays[d];
+
+		stop = 0;
+		counting = 0;
+		total_bytes = 0;
+#pragma omp parallel
+		{
+			int t = omp_get_thread_num(), nt = omp_get_num_threads();
+
+			if (t == 0) {
+				double t0;
+				int k;
+
+				chase(head, lat_loads);		/* let the load threads ramp up */
+				__atomic_store_n(&counting, 1, __ATOMIC_RELEASE);
+				t0 = mysecond();
+				for (k = 0; k < ntimes; k++)
+					samples[k] = chase(head, lat_loads);
+				elapsed = mysecond() - t0;
+				__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+			} else {
+				ssize_t lo = stream_array_size * (t - 1) / (nt - 1);
+				ssize_t hi = stream_array_size * t / (nt - 1);
+				ssize_t j, k, e;
+				double moved = 0;
+				long i;
+
+				while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+					for (j = lo; j < hi && !__atomic_load_n(&stop, __ATOMIC_ACQUIRE); j = e) {
+						e = MIN(j + LL_BLOCK, hi);
+						for (k = j; k < e; k++)
+							c[k] = b[k] + 0.5 * c[k];
+						/* only what overlaps the timed chase window counts */
+						if (__atomic_load_n(&counting, __ATOMIC_ACQUIRE))
+							moved += 3.0 * sizeof(STREAM_TYPE) * (e - j);
+						for (i = 0; i < delay; i++)
+							__asm__ __volatile__ ("" : : : "memory");
+					}
+				}
+#pragma omp atomic
+				total_bytes += moved;
+			}
+		}
+		sample_stats(samples, ntimes, warmup, &st);
+		snprintf(group, sizeof(group), "loaded:%ld", delay);
+		report_kernel(group, "Chase", (double) lat_loads * sizeof(void *), samples, ntimes);
+		/* a block in flight at either edge of the window is off by at most LL_BLOCK elements */
+		printf("%10ld %16.1f %16.2f %16.2f\n", delay, 1.0E-06 * total_bytes / elapsed,
+		    1.0E9 * st.pct[0] / lat_loads, 1.0E9 * st.min / lat_loads);
+	}
+	printf(HLINE);
+	free(samples);
+#else
+	printf("Loaded latency needs an OpenMP build\n");
+#endif
+}
+
+/*
+ * NUMA placement for the local arrays (--numa) and the node-pair matrix
+ * (--numa-matrix).  mbind() is called directly so the static build does
+ * not need libnuma.  With any policy the OpenMP threads are pinned
+ * round-robin to the CPUs the process may run on, so first touch and
+ * the kernels always see the same thread-to-CPU mapping.  Threads that a
+ * larger team adds would inherit the master's single-CPU mask, so code
+ * that changes the team size calls numa_repin() afterwards.
+ */
+#define MPOL_BIND_		2	/* <linux/mempolicy.h> */
+#define MPOL_INTERLEAVE_	3
+#define MPOL_MF_MOVE_		(1 << 1)
+#define NUMA_MAX_NODES		64
+
+static unsigned long	numa_nodes = 0;		/* node mask for bind/interleave */
+static int		numa_nnodes = 0;	/* nodes present */
+static cpu_set_t	numa_node_cpus[NUMA_MAX_NODES];
+static int		*thread_cpu = NULL;	/* binding of each OpenMP thread */
+static int		thread_cpu_count = 0;
+static cpu_set_t	numa_pin_cpus;		/* CPUs numa_setup() pinned to */
+static int		numa_pinned = 0;
+
+/* "0,2-3" -> bit mask; returns -1 on error */
+static int parse_node_list(const char *p, unsigned long *mask)
+{
+	long lo, hi;
+	char *e;
+
+	*mask = 0;
+	while (*p) {
+		lo = hi = strtol(p, &e, 10);
+		if (e == p)
+			return -1;
+		if (*e == '-')
+			hi = strtol(e + 1, &e, 10);
+		if (lo < 0 || hi < lo || hi >= NUMA_MAX_NODES)
+			return -1;
+		for (; lo <= hi; lo++)
+			*mask |= 1UL << lo;
+		if (*e == ',')
+			e++;
+		else if (*e)
+			return -1;
+		p = e;
+	}
+	return (*mask != 0) ? 0 : -1;
+}
+
+static int parse_numa(const char *arg)
+{
+	if (strcmp(arg, "firsttouch") == 0) {
+		numa_policy = NUMA_FIRSTTOUCH;
+		return 0;
+	}
+	if (strncmp(arg, "bind:", 5) == 0) {
+		numa_policy = NUMA_BIND;
+		return parse_node_list(arg + 5, &numa_nodes);
+	}
+	if (strcmp(arg, "interleave") == 0) {
+		numa_policy = NUMA_INTERLEAVE;
+		numa_nodes = 0;		/* all nodes, filled in by numa_topology() */
+		return 0;
+	}
+	if (strncmp(arg, "interleave:", 11) == 0) {
+		numa_policy = NUMA_INTERLEAVE;
+		return parse_node_list(arg + 11, &numa_nodes);
+	}
+	return -1;
+}
+
+/* read the CPUs of each node from sysfs; returns the node count */
+static int numa_topology(void)
+{
+	char path[64], list[4096];
+	unsigned long mask;
+	long lo, hi;
+	FILE *fp;
+	char *p, *e;
+	int n;
+
+	numa_nnodes = 0;
+	for (n = 0; n < NUMA_MAX_NODES; n++) {
+		CPU_ZERO(&numa_node_cpus[n]);
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+		if ((fp = fopen(path, "r")) == NULL)
+			continue;
+		if (fgets(list, sizeof(list), fp)) {
+			for (p = list; *p && *p != '\n'; p = e) {
+				lo = hi = strtol(p, &e, 10);
+				if (e == p)
+					break;
+				if (*e == '-')
+					hi = strtol(e + 1, &e, 10);
+				for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+					CPU_SET(lo, &numa_node_cpus[n]);
+				if (*e == ',')
+					e++;
+			}
+		}
+		fclose(fp);
+		numa_nnodes = n + 1;
+	}
+	if (numa_nnodes == 0) {		/* no sysfs: one node with every CPU */
+		sched_getaffinity(0, sizeof(cpu_set_t), &numa_node_cpus[0]);
+		numa_nnodes = 1;
+	}
+	mask = 0;
+	for (n = 0; n < numa_nnodes; n++)
+		mask |= 1UL << n;
+	if (numa_nodes == 0)
+		numa_nodes = mask;
+	return numa_nnodes;
+}
+
+/* pin OpenMP thread t to the t-th CPU of cpus (round-robin) */
+static void pin_threads(const cpu_set_t *cpus)
+{
+	int ncpu = CPU_COUNT(cpus);
+
+	if (ncpu == 0)
+		return;
+#pragma omp parallel
+	{
+		int t = 0, nt = 1, i, n = -1;
+		cpu_set_t one;
+
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		nt = omp_get_num_threads();
+#endif
+#pragma omp master
+		{
+			free(thread_cpu);
+			thread_cpu = calloc(nt, sizeof(int));
+			thread_cpu_count = nt;
+		}
+#pragma omp barrier
+		for (i = 0; i < CPU_SETSIZE; i++)
+			if (CPU_ISSET(i, cpus) && ++n == t % ncpu)
+				break;
+		CPU_ZERO(&one);
+		CPU_SET(i, &one);
+		sched_setaffinity(0, sizeof(one), &one);
+		thread_cpu[t] = i;
+	}
+}
+
+/* apply policy/nodes to [p, p+len); pages already touched are migrated */
+static int numa_bind_range(void *p, size_t len, int policy, unsigned long nodes)
+{
+	int mode = (policy == NUMA_INTERLEAVE) ? MPOL_INTERLEAVE_ : MPOL_BIND_;
+
+	if (policy != NUMA_BIND && policy != NUMA_INTERLEAVE)
+		return 0;
+	return syscall(SYS_mbind, p, len, mode, &nodes, (unsigned long) NUMA_MAX_NODES + 1,
+	    MPOL_MF_MOVE_);
+}
+
+/* pin the threads and bind the local arrays according to --numa */
+static int numa_setup(ssize_t buffer_size)
+{
+	cpu_set_t allowed;
+	int i;
+
+	numa_topology();
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	numa_pin_cpus = allowed;
+	numa_pinned = 1;
+	pin_threads(&numa_pin_cpus);
+	for (i = 0; i < 3; i++) {
+		if (local_array[i] && numa_bind_range(local_array[i], buffer_size, numa_policy, numa_nodes) != 0) {
+			perror("mbind");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* re-pin after omp_set_num_threads() so every thread of the new team is bound */
+static void numa_repin(void)
+{
+	if (numa_pinned)
+		pin_threads(&numa_pin_cpus);
+}
+
+static void numa_describe(void)
+{
+	int t, n;
+
+	if (numa_policy == NUMA_NONE)
+		return;
+	printf("NUMA policy for local arrays: %s", numa_policy == NUMA_FIRSTTOUCH ? "first touch" :
+	    numa_policy == NUMA_BIND ? "bind to nodes" : "interleave over nodes");
+	if (numa_policy != NUMA_FIRSTTOUCH)
+		for (n = 0; n < NUMA_MAX_NODES; n++)
+			if (numa_nodes & (1UL << n))
+				printf(" %d", n);
+	printf(" (%d node%s present)\n", numa_nnodes, numa_nnodes > 1 ? "s" : "");
+	printf("Thread binding:");
+	for (t = 0; t < thread_cpu_count; t++)
+		printf("%s %d->cpu%d", (t && t % 8 == 0) ? "\n               " : "", t, thread_cpu[t]);
+	printf("\n");
+}
+
+/*
+ * Threads pinned to node i, local arrays bound to node j, for every
+ * (i, j): the diagonal is socket-local bandwidth, the rest remote.
+ */
+static void run_numa_matrix(ssize_t stream_array_size, ssize_t buffer_size)
+{
+	double *times[NKERNELS], *rate;
+	char group[32];
+	int i, j, k, nn = numa_topology();
+
+	rate = calloc(nn * nn, sizeof(double));
+	alloc_times(times);
+	for (i = 0; i < nn; i++) {
+		if (CPU_COUNT(&numa_node_cpus[i]) == 0)
+			continue;
+		pin_threads(&numa_node_cpus[i]);
+		for (j = 0; j < nn; j++) {
+			for (k = 0; k < 3; k++)
+				if (local_array[k] && numa_bind_range(local_array[k], buffer_size, NUMA_BIND, 1UL << j) != 0)
+					break;
+			if (k < 3)
+				continue;	/* node without memory */
+			init_arrays(stream_array_size);
+			estimate_kernel_time(stream_array_size);
+			run_kernels(stream_array_size, times);
+			summarize_times(times);
+			snprintf(group, sizeof(group), "numa:%d:%d", i, j);
+			report_kernels(group, times, stream_array_size);
+			report_validation(group, checkSTREAMresults(stream_array_size));
+			rate[i * nn + j] = 1.0E-06 * bytes[3] / mintime[3];
+		}
+	}
+	printf(HLINE);
+	printf("Triad best rate MB/s, threads on node (rows) x memory on node (columns)\n");
+	printf("%8s", "");
+	for (j = 0; j < nn; j++)
+		printf("    mem%-5d", j);
+	printf("\n");
+	for (i = 0; i < nn; i++) {
+		printf("cpu%-5d", i);
+		for (j = 0; j < nn; j++)
+			printf(" %11.1f", rate[i * nn + j]);
+		printf("\n");
+	}
+	printf(HLINE);
+	free_times(times);
+	free(rate);
+}
+
+/*
+ * Non-temporal store kernels.  Same arithmetic as Copy/Scale/Add/Triad,
+ * but the destination is written without a read for ownership:
+ *	x86-64		movnti (+ sfence)
+ *	RISC-V		cbo.zero (Zicboz) on each full destination block,
+ *			then stores preceded by the ntl.all hint (Zihintntl;
+ *			a no-op on cores without it)
+ *	clang		__builtin_nontemporal_store elsewhere
+ * Each thread owns whole blocks so a cbo.zero never clears data another
+ * thread has already written.
+ */
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define NT_METHOD	"movnti"
+static inline void nt_store(STREAM_TYPE *p, STREAM_TYPE v)
+{
+	if (sizeof(STREAM_TYPE) == 8) {
+		long long bits;
+		memcpy(&bits, &v, sizeof(bits));
+		_mm_stream_si64((long long *)p, bits);
+	} else if (sizeof(STREAM_TYPE) == 4) {
+		int bits;
+		memcpy(&bits, &v, sizeof(bits));
+		_mm_stream_si32((int *)p, bits);
+	} else
+		*p = v;
+}
+#define nt_zero_block(p)	((void) (p))
+#define nt_fence()	_mm_sfence()
+#elif defined(__riscv) && __riscv_xlen == 64
+#include <sys/syscall.h>
+#define NT_METHOD	(nt_cbo_zero ? "cbo.zero + ntl.all" : "ntl.all")
+static int	nt_cbo_zero = 0;
+static inline void nt_store(STREAM_TYPE *p, STREAM_TYPE v)
+{
+	if (sizeof(STREAM_TYPE) == 8) {
+		uint64_t bits;
+		memcpy(&bits, &v, sizeof(bits));
+		__asm__ __volatile__ ("add x0, x0, x5\n\tsd %1, 0(%0)" : : "r"(p), "r"(bits) : "memory");
+	} else if (sizeof(STREAM_TYPE) == 4) {
+		uint32_t bits;
+		memcpy(&bits, &v, sizeof(bits));
+		__asm__ __volatile__ ("add x0, x0, x5\n\tsw %1, 0(%0)" : : "r"(p), "r"(bits) : "memory");
+	} else
+		*p = v;
+}
+static inline void nt_zero_block(STREAM_TYPE *p)
+{
+	if (nt_cbo_zero)
+		__asm__ __volatile__ (".insn i 0x0F, 2, x0, %0, 4" : : "r"(p) : "memory");	/* cbo.zero */
+}
+#define nt_fence()	__asm__ __volatile__ ("fence w, w" : : : "memory")
+#elif defined(__clang__)
+#define NT_METHOD	"__builtin_nontemporal_store"
+#define nt_store(p, v)	__builtin_nontemporal_store((v), (p))
+#define nt_zero_block(p)	((void) (p))
+#define nt_fence()	do { } while (0)
+#endif
+
+#ifdef NT_METHOD
+static size_t	nt_block = 64;	/* bytes per cache block */
+
+/* detect Zicboz and its block size; x86 and clang use 64-byte blocks */
+static int nt_init(void)
+{
+#if defined(__riscv) && __riscv_xlen == 64
+	struct { int64_t key; uint64_t value; } pairs[2] = {
+		{4, 0},		/* RISCV_HWPROBE_KEY_IMA_EXT_0 */
+		{6, 0},		/* RISCV_HWPROBE_KEY_ZICBOZ_BLOCK_SIZE */
+	};
+
+	if (syscall(258 /* __NR_riscv_hwprobe */, pairs, 2, 0, NULL, 0) == 0 &&
+	    (pairs[0].value & (1 << 6)) /* RISCV_HWPROBE_EXT_ZICBOZ */ && pairs[1].value > 0) {
+		nt_cbo_zero = 1;
+		nt_block = pairs[1].value;
+	}
+#endif
+	if (nt_block % sizeof(STREAM_TYPE) != 0)
+		return -1;
+	return 0;
+}
+
+/* OpenMP block partition of [0, n) rounded to whole nt_block units */
+static void nt_range(ssize_t n, ssize_t step, ssize_t *lo, ssize_t *hi)
+{
+	ssize_t blocks = (n + step - 1) / step;
+
+	thread_range(blocks, lo, hi);
+	*lo = MIN(*lo * step, n);
+	*hi = MIN(*hi * step, n);
+}
+
+#endif
+
+/* probe the block-zero instruction; call once, outside any parallel region */
+static void zero_init(void)
+{
+#if defined(__riscv) && __riscv_xlen == 64
+	nt_init();
+#endif
+}
+
+/* clear n elements at p (page aligned for --init=zero); zero_init() must have run */
+static void zero_range(STREAM_TYPE *p, ssize_t n)
+{
+	ssize_t j = 0;
+
+#if defined(__riscv) && __riscv_xlen == 64
+	ssize_t step = nt_block / sizeof(STREAM_TYPE);
+
+	if (nt_cbo_zero && (uintptr_t) p % nt_block == 0)
+		for (; j + step <= n; j += step)
+			nt_zero_block(p + j);
+#endif
+	memset(p + j, 0, (n - j) * sizeof(STREAM_TYPE));
+}
+
+#ifdef NT_METHOD
+#define NT_KERNEL(NAME, DST, EXPR) \
+static void NAME(ssize_t stream_array_size, STREAM_TYPE scalar) \
+{ \
+	_Pragma("omp parallel") \
+	{ \
+		ssize_t lo, hi, j, k, step = nt_block / sizeof(STREAM_TYPE); \
+		nt_range(stream_array_size, step, &lo, &hi); \
+		for (j = lo; j < hi; ) { \
+			k = MIN(j + step, hi); \
+			if (k - j == step) \
+				nt_zero_block(&DST[j]); \
+			for (; j < k; j++) \
+				nt_store(&DST[j], EXPR); \
+		} \
+		nt_fence(); \
+	} \
+}
+
+NT_KERNEL(nt_STREAM_Copy, c, a[j])
+NT_KERNEL(nt_STREAM_Scale, b, scalar*c[j])
+NT_KERNEL(nt_STREAM_Add, c, a[j]+b[j])
+NT_KERNEL(nt_STREAM_Triad, a, b[j]+scalar*c[j])
+
+static void run_nt_kernels(ssize_t stream_array_size, double *times[NKERNELS])
+{
+	STREAM_TYPE scalar = 3.0;
+	int k;
+
+	set_kernels_run(stream_order, STREAM_KERNELS);
+	for (k=0; k<ntimes; k++) {
+		times[0][k] = mysecond();
+		nt_STREAM_Copy(stream_array_size, scalar);
+		times[0][k] = mysecond() - times[0][k];
+
+		times[1][k] = mysecond();
+		nt_STREAM_Scale(stream_array_size, scalar);
+		times[1][k] = mysecond() - times[1][k];
+
+		times[2][k] = mysecond();
+		nt_STREAM_Add(stream_array_size, scalar);
+		times[2][k] = mysecond() - times[2][k];
+
+		times[3][k] = mysecond();
+		nt_STREAM_Triad(stream_array_size, scalar);
+		times[3][k] = mysecond() - times[3][k];
+	}
+}
+#endif
+
+/*
+ * Re-run the kernels with non-temporal stores and print both rate sets
+ * side by side.  "Link" rates count what actually crosses the memory
+ * interface: a normal store also reads the destination line for
+ * ownership (write allocate), so it moves bytes[j] + buffer_size, while
+ * a non-temporal store moves only bytes[j].
+ */
+static void run_nt_comparison(ssize_t stream_array_size, ssize_t buffer_size)
+{
+#ifdef NT_METHOD
+	double *times[NKERNELS], normal_mintime[4], link_bytes[4];
+	int j;
+
+	if (nt_init() != 0) {
+		printf("Non-temporal stores: block size %lu does not fit STREAM_TYPE, skipped\n",
+		    (unsigned long) nt_block);
+		return;
+	}
+	for (j = 0; j < 4; j++) {
+		normal_mintime[j] = mintime[j];
+		link_bytes[j] = bytes[j] + buffer_size;	/* one write-allocate read */
+	}
+
+	alloc_times(times);
+	init_arrays(stream_array_size);
+	estimate_kernel_time(stream_array_size);
+	run_nt_kernels(stream_array_size, times);
+	summarize_times(times);
+
+	report_kernels("nt", times, stream_array_size);
+	printf("Non-temporal stores: %s, %lu-byte blocks\n", NT_METHOD, (unsigned long) nt_block);
+	printf("Function    Best Rate MB/s  NT Rate MB/s  Link MB/s  NT Link MB/s\n");
+	for (j = 0; j < 4; j++) {
+		printf("%s%12.1f  %12.1f  %9.1f  %12.1f\n", kernel_table[j].label,
+		    1.0E-06 * bytes[j]/normal_mintime[j],
+		    1.0E-06 * bytes[j]/mintime[j],
+		    1.0E-06 * link_bytes[j]/normal_mintime[j],
+		    1.0E-06 * bytes[j]/mintime[j]);
+	}
+	printf(HLINE);
+	report_validation("nt", checkSTREAMresults(stream_array_size));
+	printf(HLINE);
+	free_times(times);
+#else
+	printf("Non-temporal stores are not supported on this target\n");
+	printf(HLINE);
+#endif
+}
+
+/*
+ * Machine-readable results (--format=json|csv, --output=FILE).  Kernel
+ * results and validation outcomes are collected as the modes run and
+ * written, together with the run metadata, by report_close().  Each
+ * result carries a group ("main", "nt", "place:LRR", "size:65536", ...)
+ * so the sweeps land in the same file as the plain run.  When the
+ * output is stdout the human-readable report is moved to stderr.
+ */
+#define REPORT_NONE	0
+#define REPORT_JSON	1
+#define REPORT_CSV	2
+
+struct report_meta {
+	char	key[32];
+	char	value[256];
+	int	is_number;
+};
+
+struct report_result {
+	char	group[32];
+	char	kernel[16];
+	double	bytes;
+	int	nsamples;
+	double	*samples;
+};
+
+struct report_check {
+	char	group[32];
+	int	errors;
+};
+
+static int			report_format = REPORT_NONE;
+static FILE			*report_fp = NULL;
+static struct report_meta	*report_metas = NULL;
+static struct report_result	*report_results = NULL;
+static struct report_check	*report_checks = NULL;
+static int			report_nmeta = 0, report_nresults = 0, report_nchecks = 0;
+
+static int report_open(const char *format, const char *path)
+{
+	int fd;
+
+	if (strcmp(format, "json") == 0)
+		report_format = REPORT_JSON;
+	else if (strcmp(format, "csv") == 0)
+		report_format = REPORT_CSV;
+	else
+		return -1;
+
+	if (path == NULL || strcmp(path, "-") == 0) {
+		fflush(stdout);
+		fd = dup(STDOUT_FILENO);
+		report_fp = (fd >= 0) ? fdopen(fd, "w") : NULL;
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	} else
+		report_fp = fopen(path, "w");
+	if (report_fp == NULL) {
+		report_format = REPORT_NONE;
+		return -1;
+	}
+	return 0;
+}
+
+static void report_meta(const char *key, int is_number, const char *fmt, ...)
+{
+	struct report_meta *m;
+	va_list ap;
+
+	if (report_format == REPORT_NONE)
+		return;
+	report_metas = realloc(report_metas, (report_nmeta + 1) * sizeof(*report_metas));
+	m = &report_metas[report_nmeta++];
+	snprintf(m->key, sizeof(m->key), "%s", key);
+	va_start(ap, fmt);
+	vsnprintf(m->value, sizeof(m->value), fmt, ap);
+	va_end(ap);
+	m->is_number = is_number;
+}
+
+/* samples[0..nsamples-1] are per-iteration times; the first "warmup" are excluded from the statistics */
+static void report_kernel(const char *group, const char *kernel, double nbytes,
+    const double *samples, int nsamples)
+{
+	struct report_result *r;
+
+	if (report_format == REPORT_NONE && baseline_path == NULL)
+		return;
+	report_results = realloc(report_results, (report_nresults + 1) * sizeof(*report_results));
+	r = &report_results[report_nresults++];
+	snprintf(r->group, sizeof(r->group), "%s", group);
+	snprintf(r->kernel, sizeof(r->kernel), "%s", kernel);
+	r->bytes = nbytes;
+	r->nsamples = nsamples;
+	r->samples = malloc(nsamples * sizeof(double));
+	memcpy(r->samples, samples, nsamples * sizeof(double));
+}
+
+/* the kernels of one run, times[][] as filled by run_kernels() */
+static void report_kernels(const char *group, double *times[NKERNELS], ssize_t stream_array_size)
+{
+	int s, j;
+
+	for (s = 0; s < kernels_run; s++) {
+		j = kernel_ran[s];
+		report_kernel(group, kernel_table[j].name, kernel_table[j].nbytes(stream_array_size),
+		    times[j], ntimes);
+	}
+}
+
+static void report_validation(const char *group, int errors)
+{
+	struct report_check *v;
+
+	if (report_format == REPORT_NONE)
+		return;
+	report_checks = realloc(report_checks, (report_nchecks + 1) * sizeof(*report_checks));
+	v = &report_checks[report_nchecks++];
+	snprintf(v->group, sizeof(v->group), "%s", group);
+	v->errors = errors;
+}
+
+static void json_string(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(fp, "\\u%04x", *s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+/* JSON has no inf or nan: a value that is not finite is written as null */
+static void json_number(FILE *fp, const char *fmt, double v)
+{
+	if (isfinite(v))
+		fprintf(fp, fmt, v);
+	else
+		fputs("null", fp);
+}
+
+static void csv_string(FILE *fp, const char *s)
+{
+	if (strpbrk(s, ",\"\n") == NULL) {
+		fputs(s, fp);
+		return;
+	}
+	fputc('"', fp);
+	for (; *s; s++) {
+		if (*s == '"')
+			fputc('"', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+static void report_close(void)
+{
+	FILE *fp = report_fp;
+	struct time_stats st;
+	int i, k, nout;
+
+	if (report_format == REPORT_JSON) {
+		fprintf(fp, "{\n  \"metadata\": {");
+		for (i = 0; i < report_nmeta; i++) {
+			fprintf(fp, "%s\n    ", i ? "," : "");
+			json_string(fp, report_metas[i].key);
+			fprintf(fp, ": ");
+			if (report_metas[i].is_number && isfinite(strtod(report_metas[i].value, NULL)))
+				fputs(report_metas[i].value, fp);
+			else if (report_metas[i].is_number)
+				fputs("null", fp);
+			else
+				json_string(fp, report_metas[i].value);
+		}
+		fprintf(fp, "\n  },\n  \"results\": [");
+		for (i = 0, nout = 0; i < report_nresults; i++) {
+			struct report_result *r = &report_results[i];
+
+			sample_stats(r->samples, r->nsamples, warmup, &st);
+			if (st.n == 0)
+				continue;	/* nothing past the warm-up */
+			fprintf(fp, "%s\n    {\"group\": ", nout++ ? "," : "");
+			json_string(fp, r->group);
+			fprintf(fp, ", \"kernel\": ");
+			json_string(fp, r->kernel);
+			fprintf(fp, ", \"bytes\": ");
+			json_number(fp, "%.0f", r->bytes);
+			fprintf(fp, ", \"best_rate_mbs\": ");
+			json_number(fp, "%.3f", 1.0E-06 * r->bytes / st.min);
+			fprintf(fp, ", \"avg_time\": ");
+			json_number(fp, "%.9f", st.avg);
+			fprintf(fp, ", \"min_time\": ");
+			json_number(fp, "%.9f", st.min);
+			fprintf(fp, ", \"max_time\": ");
+			json_number(fp, "%.9f", st.max);
+			fprintf(fp, ",\n     \"median_time\": ");
+			json_number(fp, "%.9f", st.pct[0]);
+			fprintf(fp, ", \"p90_time\": ");
+			json_number(fp, "%.9f", st.pct[1]);
+			fprintf(fp, ", \"p99_time\": ");
+			json_number(fp, "%.9f", st.pct[2]);
+			fprintf(fp, ", \"p99_9_time\": ");
+			json_number(fp, "%.9f", st.pct[3]);
+			fprintf(fp, ", \"stddev_time\": ");
+			json_number(fp, "%.9f", st.stddev);
+			fprintf(fp, ",\n     \"samples\": [");
+			for (k = 0; k < r->nsamples; k++) {
+				fprintf(fp, "%s", k ? ", " : "");
+				json_number(fp, "%.9f", r->samples[k]);
+			}
+			fprintf(fp, "]}");
+		}
+		fprintf(fp, "\n  ],\n  \"validation\": [");
+		for (i = 0; i < report_nchecks; i++) {
+			fprintf(fp, "%s\n    {\"group\": ", i ? "," : "");
+			json_string(fp, report_checks[i].group);
+			fprintf(fp, ", \"errors\": %d}", report_checks[i].errors);
+		}
+		fprintf(fp, "\n  ]\n}\n");
+	} else if (report_format == REPORT_CSV) {
+		fprintf(fp, "# meta,key,value\n");
+		for (i = 0; i < report_nmeta; i++) {
+			fprintf(fp, "meta,%s,", report_metas[i].key);
+			csv_string(fp, report_metas[i].value);
+			fprintf(fp, "\n");
+		}
+		fprintf(fp, "# result,group,kernel,bytes,best_rate_mbs,avg_time,min_time,max_time,"
+		    "median_time,p90_time,p99_time,p99_9_time,stddev_time\n");
+		for (i = 0; i < report_nresults; i++) {
+			struct report_result *r = &report_results[i];
+
+			sample_stats(r->samples, r->nsamples, warmup, &st);
+			if (st.n == 0)
+				continue;
+			fprintf(fp, "result,%s,%s,%.0f,%.3f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n",
+			    r->group, r->kernel, r->bytes, 1.0E-06 * r->bytes / st.min, st.avg, st.min, st.max,
+			    st.pct[0], st.pct[1], st.pct[2], st.pct[3], st.stddev);
+		}
+		fprintf(fp, "# sample,group,kernel,iteration,seconds\n");
+		for (i = 0; i < report_nresults; i++)
+			for (k = 0; report_results[i].nsamples > warmup && k < report_results[i].nsamples; k++)
+				fprintf(fp, "sample,%s,%s,%d,%.9f\n", report_results[i].group,
+				    report_results[i].kernel, k, report_results[i].samples[k]);
+		fprintf(fp, "# validation,group,errors\n");
+		for (i = 0; i < report_nchecks; i++)
+			fprintf(fp, "validation,%s,%d\n", report_checks[i].group, report_checks[i].errors);
+	}
+	if (report_fp)
+		fclose(report_fp);
+	report_fp = NULL;
+	for (i = 0; i < report_nresults; i++)
+		free(report_results[i].samples);
+	free(report_results);
+	free(report_metas);
+	free(report_checks);
+	report_format = REPORT_NONE;
+}
+
+/*
+ * Regression gate (--baseline=FILE).  FILE is a --format=json or csv
+ * report of an earlier run; every result here whose group and kernel are
+ * in FILE is compared on the best and the median rate.  A result has
+ * regressed when either rate dropped by more than --tolerance percent and
+ * a one-sided Mann-Whitney U test over the per-iteration rates (warm-up
+ * iterations excluded on both sides) says the drop is not noise at the
+ * given alpha; with fewer than three samples on a side only the
+ * threshold applies.  Any regression makes the run exit with status 1.
+ */
+struct baseline_result {
+	char	group[32];
+	char	kernel[16];
+	double	bytes;
+	int	nsamples;
+	double	*samples;
+};
+static struct baseline_result	*baseline_results = NULL;
+static int			baseline_nresults = 0, baseline_warmup = 1;
+
+static struct baseline_result *baseline_find(const char *group, const char *kernel, int create)
+{
+	struct baseline_result *b;
+	int i;
+
+	for (i = 0; i < baseline_nresults; i++)
+		if (strcmp(baseline_results[i].group, group) == 0 && strcmp(baseline_results[i].kernel, kernel) == 0)
+			return &baseline_results[i];
+	if (!create)
+		return NULL;
+	baseline_results = realloc(baseline_results, (baseline_nresults + 1) * sizeof(*baseline_results));
+	b = &baseline_results[baseline_nresults++];
+	memset(b, 0, sizeof(*b));
+	snprintf(b->group, sizeof(b->group), "%s", group);
+	snprintf(b->kernel, sizeof(b->kernel), "%s", kernel);
+	return b;
+}
+
+static void baseline_add_sample(struct baseline_result *b, double t)
+{
+	b->samples = realloc(b->samples, (b->nsamples + 1) * sizeof(double));
+	b->samples[b->nsamples++] = t;
+}
+
+/*
+ * Strict reader for the JSON report_close() writes: a "metadata" object
+ * (only "warmup" is used), then "results" with one object per kernel and
+ * the keys in report_close()'s order, then "validation".  Anything else,
+ * a missing key or a duplicate result is an error.
+ */
+struct json_parser {
+	const char	*p, *start;
+	int		failed;		/* only the first error is printed */
+};
+
+static int jp_error(struct json_parser *jp, const char *what)
+{
+	if (!jp->failed++)
+		printf("Baseline: expected %s at byte %ld\n", what, (long)(jp->p - jp->start));
+	return -1;
+}
+
+static void jp_space(struct json_parser *jp)
+{
+	jp->p += strspn(jp->p, " \t\r\n");
+}
+
+/* the literal token tok, e.g. "{" or "null"; 0 if it is next */
+static int jp_token(struct json_parser *jp, const char *tok)
+{
+	jp_space(jp);
+	if (strncmp(jp->p, tok, strlen(tok)) != 0)
+		return -1;
+	jp->p += strlen(tok);
+	return 0;
+}
+
+/* a string into out[len]; out == NULL skips it */
+static int jp_string(struct json_parser *jp, char *out, size_t len)
+{
+	size_t n = 0;
+	unsigned u;
+
+	jp_space(jp);
+	if (*jp->p != '"')
+		return jp_error(jp, "a string");
+	for (jp->p++; *jp->p != '"'; jp->p++) {
+		char ch = *jp->p;
+
+		if (ch == '\0' || (unsigned char) ch < 0x20)
+			return jp_error(jp, "the end of the string");
+		if (ch == '\\') {
+			ch = *++jp->p;
+			if (ch == 'u' && sscanf(jp->p + 1, "%4x", &u) == 1 && u < 0x80) {
+				ch = (char) u;
+				jp->p += 4;
+			} else if (ch != '"' && ch != '\\' && ch != '/')
+				return jp_error(jp, "a string escape");
+		}
+		if (out == NULL)
+			continue;
+		if (n + 1 >= len)
+			return jp_error(jp, "a shorter string");
+		out[n++] = ch;
+	}
+	jp->p++;
+	if (out)
+		out[n] = '\0';
+	return 0;
+}
+
+/* a number, or null (NAN) if allow_null */
+static int jp_number(struct json_parser *jp, double *v, int allow_null)
+{
+	char *end;
+
+	if (allow_null && jp_token(jp, "null") == 0) {
+		*v = NAN;
+		return 0;
+	}
+	jp_space(jp);
+	*v = strtod(jp->p, &end);
+	if (end == jp->p || !isfinite(*v))
+		return jp_error(jp, allow_null ? "a number or null" : "a number");
+	jp->p = end;
+	return 0;
+}
+
+/* "key": */
+static int jp_key(struct json_parser *jp, const char *key)
+{
+	char name[64], what[80];
+
+	snprintf(what, sizeof(what), "\"%s\"", key);
+	if (jp_string(jp, name, sizeof(name)) != 0 || strcmp(name, key) != 0)
+		return jp_error(jp, what);
+	if (jp_token(jp, ":") != 0)
+		return jp_error(jp, "':'");
+	return 0;
+}
+
+static int baseline_json_result(struct json_parser *jp)
+{
+	static const char *stats[] = {"best_rate_mbs", "avg_time", "min_time", "max_time", "median_time",
+	    "p90_time", "p99_time", "p99_9_time", "stddev_time"};
+	char group[32], kernel[16];
+	struct baseline_result *b;
+	double v;
+	int i;
+
+	if (jp_token(jp, "{") != 0)
+		return jp_error(jp, "'{' of a result");
+	if (jp_key(jp, "group") || jp_string(jp, group, sizeof(group)) || jp_token(jp, ",") ||
+	    jp_key(jp, "kernel") || jp_string(jp, kernel, sizeof(kernel)) || jp_token(jp, ","))
+		return jp_error(jp, "a result's group and kernel");
+	if (baseline_find(group, kernel, 0) != NULL)
+		return jp_error(jp, "no duplicate result");
+	b = baseline_find(group, kernel, 1);
+	if (jp_key(jp, "bytes") || jp_number(jp, &b->bytes, 0) || b->bytes <= 0)
+		return jp_error(jp, "a positive byte count");
+	for (i = 0; i < (int)(sizeof(stats) / sizeof(stats[0])); i++)
+		if (jp_token(jp, ",") || jp_key(jp, stats[i]) || jp_number(jp, &v, 1))
+			return jp_error(jp, stats[i]);
+	if (jp_token(jp, ",") || jp_key(jp, "samples") || jp_token(jp, "["))
+		return jp_error(jp, "\"samples\": [");
+	if (jp_token(jp, "]") != 0) {
+		do {
+			if (jp_number(jp, &v, 0) != 0)
+				return -1;
+			baseline_add_sample(b, v);
+		} while (jp_token(jp, ",") == 0);
+		if (jp_token(jp, "]") != 0)
+			return jp_error(jp, "']' after the samples");
+	}
+	if (jp_token(jp, "}") != 0)
+		return jp_error(jp, "'}' after the samples");
+	return 0;
+}
+
+static int baseline_parse_json(char *buf)
+{
+	struct json_parser jp = {buf, buf, 0};
+	char key[64];
+	double v;
+	int have_warmup = 0;
 
-    printf("\rEach test below will take on the order"
-	" of %d microseconds.\n", (int) t  );
-    printf("   (= %d clock ticks)\n", (int) (t/quantum) );
-    printf("Increase the size of the arrays if this shows that\n");
-    printf("you are not getting at least 20 clock ticks per test.\n");
+	if (jp_token(&jp, "{") || jp_key(&jp, "metadata") || jp_token(&jp, "{"))
+		return jp_error(&jp, "{\"metadata\": {");
+	if (jp_token(&jp, "}") != 0) {
+		do {
+			if (jp_string(&jp, key, sizeof(key)) || jp_token(&jp, ":"))
+				return jp_error(&jp, "a metadata key");
+			jp_space(&jp);
+			v = NAN;
+			if (*jp.p == '"') {
+				if (jp_string(&jp, NULL, 0) != 0)
+					return -1;
+			} else if (jp_number(&jp, &v, 1) != 0)
+				return -1;
+			if (strcmp(key, "warmup") == 0) {
+				if (isnan(v) || v < 0 || v != (int) v)
+					return jp_error(&jp, "a warmup count");
+				baseline_warmup = (int) v;
+				have_warmup = 1;
+			}
+		} while (jp_token(&jp, ",") == 0);
+		if (jp_token(&jp, "}") != 0)
+			return jp_error(&jp, "'}' after the metadata");
+	}
+	if (!have_warmup)
+		return jp_error(&jp, "a \"warmup\" entry in the metadata");
+	if (jp_token(&jp, ",") || jp_key(&jp, "results") || jp_token(&jp, "["))
+		return jp_error(&jp, "\"results\": [");
+	if (jp_token(&jp, "]") != 0) {
+		do {
+			if (baseline_json_result(&jp) != 0)
+				return -1;
+		} while (jp_token(&jp, ",") == 0);
+		if (jp_token(&jp, "]") != 0)
+			return jp_error(&jp, "']' after the results");
+	}
+	/* "validation" is checked for shape only */
+	if (jp_token(&jp, ",") || jp_key(&jp, "validation") || jp_token(&jp, "["))
+		return jp_error(&jp, "\"validation\": [");
+	if (jp_token(&jp, "]") != 0) {
+		do {
+			if (jp_token(&jp, "{") || jp_key(&jp, "group") || jp_string(&jp, NULL, 0) ||
+			    jp_token(&jp, ",") || jp_key(&jp, "errors") || jp_number(&jp, &v, 0) ||
+			    jp_token(&jp, "}"))
+				return jp_error(&jp, "a validation entry");
+		} while (jp_token(&jp, ",") == 0);
+		if (jp_token(&jp, "]") != 0)
+			return jp_error(&jp, "']' after the validation entries");
+	}
+	if (jp_token(&jp, "}") != 0)
+		return jp_error(&jp, "'}' at the end");
+	jp_space(&jp);
+	if (*jp.p != '\0')
+		return jp_error(&jp, "the end of the file");
+	return 0;
+}
 
-    printf(HLINE);
+static int baseline_parse_csv(char *buf)
+{
+	char group[32], kernel[16], *line, *save;
+	struct baseline_result *b;
+	double v;
+	int k;
 
-    printf("WARNING -- The above is only a rough guideline.\n");
-    printf("For best results, please be sure you know the\n");
-    printf("precision of your system timer.\n");
-    printf(HLINE);
-    
-    /*	--- MAIN LOOP --- repeat test cases NTIMES times --- */
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		if (sscanf(line, "meta,warmup,%d", &baseline_warmup) == 1)
+			continue;
+		if (sscanf(line, "result,%31[^,],%15[^,],%lf", group, kernel, &v) == 3) {
+			if (baseline_find(group, kernel, 0) != NULL || !(v > 0))
+				goto bad;
+			baseline_find(group, kernel, 1)->bytes = v;
+		} else if (sscanf(line, "sample,%31[^,],%15[^,],%d,%lf", group, kernel, &k, &v) == 4) {
+			if ((b = baseline_find(group, kernel, 0)) == NULL || k != b->nsamples || !isfinite(v))
+				goto bad;
+			baseline_add_sample(b, v);
+		} else if (line[0] != '#' && strncmp(line, "meta,", 5) != 0 &&
+		    strncmp(line, "validation,", 11) != 0)
+			goto bad;
+	}
+	return 0;
+bad:
+	printf("Baseline: unexpected line \"%.60s\"\n", line);
+	return -1;
+}
 
-    scalar = 3.0;
-    for (k=0; k<NTIMES; k++)
-	{
-	times[0][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Copy(stream_array_size);
-#else
-#pragma omp parallel for
-	for (j=0; j<stream_array_size; j++) {
-	    PRINT_LOG(j);
-	    PRINT_PROGRESS("COPY (c = a)", j);
-	    c[j] = a[j];
+static int baseline_load(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char *buf;
+	long len;
+	int rc;
+
+	if (fp == NULL) {
+		printf("Cannot open baseline %s: %s\n", path, strerror(errno));
+		return -1;
 	}
-#endif
-	times[0][k] = mysecond() - times[0][k];
-	
-	times[1][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Scale(scalar, stream_array_size);
-#else
-#pragma omp parallel for
-	for (j=0; j<stream_array_size; j++) {
-	    PRINT_LOG(j);
-	    PRINT_PROGRESS("SCALE (b = 3.0*c)", j);
-	    b[j] = scalar*c[j];
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	buf = malloc(len + 1);
+	if (buf == NULL || fread(buf, 1, len, fp) != (size_t) len) {
+		printf("Cannot read baseline %s\n", path);
+		fclose(fp);
+		free(buf);
+		return -1;
 	}
-#endif
-	times[1][k] = mysecond() - times[1][k];
-	
-	times[2][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Add(stream_array_size);
-#else
-#pragma omp parallel for
-	for (j=0; j<stream_array_size; j++) {
-	    PRINT_LOG(j);
-	    PRINT_PROGRESS("ADD (c = a + b)", j);
-	    c[j] = a[j]+b[j];
+	buf[len] = '\0';
+	fclose(fp);
+	rc = (buf[strspn(buf, " \t\r\n")] == '{') ? baseline_parse_json(buf) : baseline_parse_csv(buf);
+	free(buf);
+	if (rc != 0) {
+		printf("Cannot parse baseline %s\n", path);
+		return -1;
 	}
-#endif
-	times[2][k] = mysecond() - times[2][k];
-	
-	times[3][k] = mysecond();
-#ifdef TUNED
-        tuned_STREAM_Triad(scalar, stream_array_size);
-#else
-#pragma omp parallel for
-	for (j=0; j<stream_array_size; j++) {
-	    PRINT_LOG(j);
-	    PRINT_PROGRESS("TRIAD (a = b + 3.0*c)", j);
-	    a[j] = b[j]+scalar*c[j];
+	if (baseline_nresults == 0) {
+		printf("No results found in baseline %s\n", path);
+		return -1;
 	}
-#endif
-	times[3][k] = mysecond() - times[3][k];
+	return 0;
+}
+
+struct ranked {
+	double	v;
+	int	from_x;
+};
+
+static int cmp_ranked(const void *x, const void *y)
+{
+	return cmp_double(&((const struct ranked *) x)->v, &((const struct ranked *) y)->v);
+}
+
+/*
+ * One-sided Mann-Whitney U test, normal approximation with a continuity
+ * correction and mid-ranks for ties: the p-value for x[] being
+ * stochastically smaller than y[]; -1 when either side has fewer than
+ * three values.
+ */
+static double mann_whitney_p(const double *x, int nx, const double *y, int ny)
+{
+	struct ranked *v;
+	double rx = 0, u, sd;
+	int i, j, k, n = nx + ny;
+
+	if (nx < 3 || ny < 3)
+		return -1.0;
+	v = malloc(n * sizeof(*v));
+	for (i = 0; i < nx; i++)
+		v[i] = (struct ranked) {x[i], 1};
+	for (i = 0; i < ny; i++)
+		v[nx + i] = (struct ranked) {y[i], 0};
+	qsort(v, n, sizeof(*v), cmp_ranked);
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && v[j].v == v[i].v; j++)
+			;
+		for (k = i; k < j; k++)	/* ranks i+1 .. j share their mean */
+			if (v[k].from_x)
+				rx += 0.5 * (i + 1 + j);
 	}
+	free(v);
+	u = rx - 0.5 * nx * (nx + 1);
+	sd = sqrt(nx * ny * (n + 1) / 12.0);
+	return 0.5 * erfc(-((u - 0.5 * nx * ny + 0.5) / sd) / sqrt(2.0));
+}
 
-    /*	--- SUMMARY --- */
+/* per-iteration rates in MB/s of samples[skip..n-1] */
+static double *sample_rates(const double *samples, int n, int skip, double nbytes, int *count)
+{
+	double *r = malloc(MAX(n - skip, 1) * sizeof(double));
+	int k;
 
-    for (k=1; k<NTIMES; k++) /* note -- skip first iteration */
-	{
-	for (j=0; j<4; j++)
-	    {
-	    avgtime[j] = avgtime[j] + times[j][k];
-	    mintime[j] = MIN(mintime[j], times[j][k]);
-	    maxtime[j] = MAX(maxtime[j], times[j][k]);
-	    }
-	}
-    
-    printf("\rFunction    Best Rate MB/s  Avg time     Min time     Max time\n");
-    for (j=0; j<4; j++) {
-		avgtime[j] = avgtime[j]/(double)(NTIMES-1);
-
-		printf("%s%12.1f  %11.6f  %11.6f  %11.6f\n", label[j],
-	       1.0E-06 * bytes[j]/mintime[j],
-	       avgtime[j],
-	       mintime[j],
-	       maxtime[j]);
-    }
-    printf(HLINE);
+	*count = 0;
+	for (k = skip; k < n; k++)
+		if (samples[k] > 0)
+			r[(*count)++] = 1.0E-06 * nbytes / samples[k];
+	return r;
+}
 
-    /* --- Check Results --- */
-    checkSTREAMresults(stream_array_size);
-    printf(HLINE);
+/* returns the number of regressed results, -1 if the baseline can't be read */
+static int baseline_compare(const char *path)
+{
+	struct baseline_result *b;
+	struct time_stats cs, bs;
+	double *cr, *br, best, bbest, med, bmed, dbest, dmed, p;
+	int i, nc, nb, regressed = 0, compared = 0, bad;
 
-    //swsok
-    if ( argc > 1 ) {
-	munmap(a, buffer_size);
-	munmap(b, buffer_size);
-	munmap(c, buffer_size);
-	if ( fid ) close(fid);
-    }
+	if (baseline_load(path) != 0)
+		return -1;
+	printf("Baseline comparison against %s (tolerance %.1f%%, alpha %.3f)\n", path,
+	    baseline_tolerance, baseline_alpha);
+	printf("%-20s %-7s %11s %9s %11s %9s %8s  %s\n", "Group", "Kernel", "Best MB/s", "Change",
+	    "Median MB/s", "Change", "p", "Verdict");
+	for (i = 0; i < report_nresults; i++) {
+		struct report_result *r = &report_results[i];
 
-    return 0;
+		if ((b = baseline_find(r->group, r->kernel, 0)) == NULL || b->nsamples <= baseline_warmup ||
+		    r->nsamples <= warmup)
+			continue;
+		sample_stats(r->samples, r->nsamples, warmup, &cs);
+		sample_stats(b->samples, b->nsamples, baseline_warmup, &bs);
+		best = 1.0E-06 * r->bytes / cs.min;
+		bbest = 1.0E-06 * b->bytes / bs.min;
+		med = 1.0E-06 * r->bytes / cs.pct[0];
+		bmed = 1.0E-06 * b->bytes / bs.pct[0];
+		dbest = 100.0 * (best / bbest - 1.0);
+		dmed = 100.0 * (med / bmed - 1.0);
+		cr = sample_rates(r->samples, r->nsamples, warmup, r->bytes, &nc);
+		br = sample_rates(b->samples, b->nsamples, baseline_warmup, b->bytes, &nb);
+		p = mann_whitney_p(cr, nc, br, nb);
+		free(cr);
+		free(br);
+		bad = (dbest < -baseline_tolerance || dmed < -baseline_tolerance) && (p < 0 || p < baseline_alpha);
+		regressed += bad;
+		compared++;
+		printf("%-20s %-7s %11.1f %+8.1f%% %11.1f %+8.1f%% ", r->group, r->kernel, best, dbest, med, dmed);
+		if (p < 0)
+			printf("%8s", "-");
+		else
+			printf("%8.4f", p);
+		printf("  %s\n", bad ? "REGRESSED" : (dbest > baseline_tolerance && dmed > baseline_tolerance) ?
+		    "improved" : "ok");
+	}
+	if (compared == 0)
+		printf("No result of this run is in the baseline\n");
+	else if (regressed)
+		printf("%d of %d results regressed beyond %.1f%%\n", regressed, compared, baseline_tolerance);
+	else
+		printf("No regressions in %d results\n", compared);
+	printf(HLINE);
+	report_meta("baseline", 0, "%s", path);
+	report_meta("baseline_compared", 1, "%d", compared);
+	report_meta("baseline_regressions", 1, "%d", regressed);
+	for (i = 0; i < baseline_nresults; i++)
+		free(baseline_results[i].samples);
+	free(baseline_results);
+	baseline_results = NULL;
+	baseline_nresults = 0;
+	return regressed;
 }
 
 # define	M	20
@@ -536,21 +6452,157 @@ double mysecond()
         return ( (double) tp.tv_sec + (double) tp.tv_usec * 1.e-6 );
 }
 #else
-static uintptr_t rdcycle()
+/*
+ * Timer subsystem.  mysecond() reads a free-running counter chosen by
+ * timer_init() and converts it to seconds with a frequency calibrated
+ * against CLOCK_MONOTONIC at startup:
+ *	cycle	- rdcycle (RISC-V), rdtsc (x86), cntvct_el0 (AArch64)
+ *	time	- rdtime (RISC-V), cntvct_el0 (AArch64)
+ *	clock	- clock_gettime(CLOCK_MONOTONIC), always available
+ * "auto" tries them in that order.  Counters that trap in user mode
+ * (e.g. rdcycle on kernels that disable it) are detected by catching
+ * SIGILL and skipped.
+ */
+#define TIMER_CALIBRATION_NS	100000000	/* 100 ms */
+
+static uint64_t read_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#if defined(__riscv)
+static uint64_t read_cycle(void)
 {
   uintptr_t out;
   __asm__ __volatile__ ("rdcycle %0" : "=r"(out));
   return out;
 }
 
-//100MHz
-#define CLOCK_PER_SEC 100000000
+static uint64_t read_time(void)
+{
+  uintptr_t out;
+  __asm__ __volatile__ ("rdtime %0" : "=r"(out));
+  return out;
+}
+#define CYCLE_NAME	"rdcycle"
+#define TIME_NAME	"rdtime"
+#elif defined(__aarch64__)
+static uint64_t read_time(void)
+{
+  uint64_t out;
+  __asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r"(out) : : "memory");
+  return out;
+}
+#define read_cycle	read_time
+#define CYCLE_NAME	"cntvct_el0"
+#define TIME_NAME	"cntvct_el0"
+#elif defined(__x86_64__) || defined(__i386__)
+static uint64_t read_cycle(void)
+{
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+#define CYCLE_NAME	"rdtsc"
+#endif
+
+static uint64_t		(*timer_read)(void) = read_clock;
+static const char	*timer_name = "clock_gettime";
+static double		timer_hz = 1.0E9;
+static uint64_t		timer_base = 0;
+static sigjmp_buf	timer_probe_env;
+
+static void timer_probe_handler(int sig)
+{
+	siglongjmp(timer_probe_env, 1);
+}
+
+/* returns 1 if read() can be executed in user mode and advances */
+static int timer_probe(uint64_t (*read)(void))
+{
+	struct sigaction sa, old_sa;
+	volatile int ok = 0;
+	uint64_t t0, t1, deadline;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = timer_probe_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGILL, &sa, &old_sa);
+	if (sigsetjmp(timer_probe_env, 1) == 0) {
+		t0 = read();
+		deadline = read_clock() + 1000000;	/* 1 ms */
+		while (read_clock() < deadline)
+			;
+		t1 = read();
+		ok = (t1 > t0);
+	}
+	sigaction(SIGILL, &old_sa, NULL);
+	return ok;
+}
+
+/* counter ticks per second, measured against CLOCK_MONOTONIC */
+static double timer_calibrate(uint64_t (*read)(void))
+{
+	uint64_t ns0, ns1, c0, c1;
+
+	ns0 = read_clock();
+	c0 = read();
+	while (read_clock() - ns0 < TIMER_CALIBRATION_NS)
+		;
+	c1 = read();
+	ns1 = read_clock();
+	return (double)(c1 - c0) / ((double)(ns1 - ns0) * 1.0E-9);
+}
+
+/* name is "auto", "cycle", "time" or "clock"; returns -1 if unavailable */
+int timer_init(const char *name)
+{
+	int any = (strcmp(name, "auto") == 0);
+
+	timer_read = NULL;
+#ifdef CYCLE_NAME
+	if (timer_read == NULL && (any || strcmp(name, "cycle") == 0) && timer_probe(read_cycle)) {
+		timer_read = read_cycle;
+		timer_name = CYCLE_NAME;
+	}
+#endif
+#ifdef TIME_NAME
+	if (timer_read == NULL && (any || strcmp(name, "time") == 0) && timer_probe(read_time)) {
+		timer_read = read_time;
+		timer_name = TIME_NAME;
+	}
+#endif
+	if (timer_read == NULL && (any || strcmp(name, "clock") == 0)) {
+		timer_read = read_clock;
+		timer_name = "clock_gettime";
+		timer_hz = 1.0E9;
+	}
+	if (timer_read == NULL) {
+		timer_read = read_clock;
+		return -1;
+	}
+	if (timer_read != read_clock)
+		timer_hz = timer_calibrate(timer_read);
+	timer_base = timer_read();
+	return 0;
+}
+
+const char *timer_source(void)
+{
+	return timer_name;
+}
+
+double timer_frequency(void)
+{
+	return timer_hz;
+}
+
 double mysecond()
 {
-	double t = 0;
-	uintptr_t clockcounter = rdcycle();
-	t = (double)clockcounter / CLOCK_PER_SEC;
-	return t;
+	return (double)(timer_read() - timer_base) / timer_hz;
 }
 #endif
 
@@ -558,44 +6610,172 @@ double mysecond()
 #ifndef abs
 #define abs(a) ((a) >= 0 ? (a) : -(a))
 #endif
-void checkSTREAMresults (ssize_t stream_array_size)
+
+/*
+ * Validation works on 64-byte cache lines.  --validate=every:N checks
+ * every N-th line and --validate=random:N checks N random lines instead
+ * of all of them ("full"), which keeps validation of a multi-GiB device
+ * window from taking longer than the benchmark.  Random lines are drawn
+ * without replacement, so N samples cover N distinct lines.  Sample s
+ * covers line validate_line(s).  A failing array gets an error map of region-sized
+ * address ranges, as device offsets for remote arrays.
+ */
+static ssize_t	*random_lines = NULL, random_lines_n = 0, random_lines_total = 0;
+
+static ssize_t validate_samples(ssize_t nlines)
+{
+	ssize_t s, l;
+
+	switch (validate_mode) {
+	case VALIDATE_EVERY:
+		return (nlines + validate_param - 1) / validate_param;
+	case VALIDATE_RANDOM:
+		if (validate_param >= nlines)
+			return nlines;
+		if (random_lines_total != nlines) {
+			free(random_lines);
+			random_lines = malloc(validate_param * sizeof(ssize_t));
+			/* selection sampling: take line l with probability need / left */
+			for (s = 0, l = 0; s < validate_param; l++)
+				if (rng_next() % (uint64_t)(nlines - l) < (uint64_t)(validate_param - s))
+					random_lines[s++] = l;
+			random_lines_n = validate_param;
+			random_lines_total = nlines;
+		}
+		return random_lines_n;
+	default:
+		return nlines;
+	}
+}
+
+static ssize_t validate_line(ssize_t s, ssize_t nlines)
+{
+	if (validate_mode == VALIDATE_EVERY)
+		return s * validate_param;
+	if (validate_mode == VALIDATE_RANDOM && validate_param < nlines)
+		return random_lines[s];
+	return s;
+}
+
+/* sum of |x[j] - expected| over the sampled lines; *checked gets the element count */
+static double array_error_sum(const STREAM_TYPE *x, STREAM_TYPE expected, ssize_t n, ssize_t *checked)
+{
+	ssize_t line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1), nlines = (n + line - 1) / line;
+	ssize_t nsamples = validate_samples(nlines), s, j, hi, count = 0;
+	double sum = 0;
+
+#pragma omp parallel for reduction(+:sum,count) private(j, hi)
+	for (s = 0; s < nsamples; s++) {
+		j = validate_line(s, nlines) * line;
+		hi = MIN(j + line, n);
+		for (; j < hi; j++)
+			sum += abs(x[j] - expected);
+		count += hi - validate_line(s, nlines) * line;
+	}
+	*checked = count;
+	return sum;
+}
+
+/* count, print per region and return the sampled elements of x[] that miscompare */
+static ssize_t array_error_map(const char *name, int i, const STREAM_TYPE *x, STREAM_TYPE expected,
+    double epsilon, ssize_t n)
+{
+	ssize_t line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1), nlines = (n + line - 1) / line;
+	ssize_t nsamples = validate_samples(nlines), region, nregions, s, j, hi, ierr = 0, *map;
+	unsigned long base;
+	int r, shown = 0, remote = (x == remote_array[i]) && nstripe == 0;
+
+	region = error_map_bytes ? error_map_bytes : MAX((ssize_t)(n * sizeof(STREAM_TYPE) / 16), 4096);
+	region = MAX(region / (ssize_t)sizeof(STREAM_TYPE), line);
+	nregions = (n + region - 1) / region;
+	map = calloc(nregions, sizeof(ssize_t));
+	if (map == NULL)
+		printf("     Cannot allocate the error map for %s[], counting errors only\n", name);
+#pragma omp parallel for reduction(+:ierr) private(j, hi)
+	for (s = 0; s < nsamples; s++) {
+		j = validate_line(s, nlines) * line;
+		hi = MIN(j + line, n);
+		for (; j < hi; j++) {
+			if (value_differs(x[j], expected, epsilon)) {
+				ierr++;
+				if (map) {
+#pragma omp atomic
+					map[j / region]++;
+				}
+			}
+		}
+	}
+#ifdef VERBOSE
+	for (j = 0, s = 0; j < n && s < 10; j++) {
+		if (value_differs(x[j], expected, epsilon)) {
+			s++;
+			printf("         array %s: index: %ld, expected: %e, observed: %e\n",
+				name, j, expected, x[j]);
+		}
+	}
+#endif
+	if (map == NULL)
+		return ierr;
+	base = remote ? (unsigned long)(remote_offset + i * remote_bytes) : 0;
+	printf("     Error map for %s[] (%s, %ld-byte regions):\n", name,
+	    remote ? "device offsets" : "array offsets", (long)(region * sizeof(STREAM_TYPE)));
+	for (r = 0; r < nregions; r++) {
+		if (map[r] == 0)
+			continue;
+		if (shown++ == 32) {
+			printf("       ...\n");
+			break;
+		}
+		printf("       0x%012lx - 0x%012lx: %ld errors\n",
+		    base + (unsigned long)(r * region * sizeof(STREAM_TYPE)),
+		    base + (unsigned long)(MIN((r + 1) * region, n) * sizeof(STREAM_TYPE)) - 1, (long) map[r]);
+	}
+	free(map);
+	return ierr;
+}
+
+/* average error relative to expected, absolute when expected is 0; NaN never passes */
+static int avg_error_fails(double avgerr, STREAM_TYPE expected, double epsilon)
+{
+	double err = (expected == 0) ? fabs(avgerr) : fabs(avgerr / expected);
+
+	return !(err <= epsilon);
+}
+
+/* returns the number of arrays that failed validation */
+int checkSTREAMresults (ssize_t stream_array_size)
 {
 	STREAM_TYPE aj,bj,cj,scalar;
+	struct stream_model m;
 	STREAM_TYPE aSumErr,bSumErr,cSumErr;
 	STREAM_TYPE aAvgErr,bAvgErr,cAvgErr;
 	double epsilon;
-	ssize_t	j;
-	int	k,ierr,err;
+	ssize_t	ierr, checked;
+	int	k,s,err;
 
     /* reproduce initialization */
-	aj = 1.0;
-	bj = 2.0;
-	cj = 0.0;
+	m.a = init_a;
+	m.b = init_b;
+	m.c = init_c;
+	m.read_sum = m.mix_sum = 0;
     /* a[] is modified during timing check */
-	aj = 2.0E0 * aj;
+	m.a = 2.0E0 * m.a;
     /* now execute timing loop */
 	scalar = 3.0;
-	for (k=0; k<NTIMES; k++)
-        {
-            cj = aj;
-            bj = scalar*cj;
-            cj = aj+bj;
-            aj = bj+scalar*cj;
-        }
+	for (k=0; k<ntimes; k++)
+	    for (s=0; s<kernels_run; s++)
+		kernel_table[kernel_ran[s]].model(&m, scalar, stream_array_size);
+	aj = m.a;
+	bj = m.b;
+	cj = m.c;
 
     /* accumulate deltas between observed and expected results */
-	aSumErr = 0.0;
-	bSumErr = 0.0;
-	cSumErr = 0.0;
-	for (j=0; j<stream_array_size; j++) {
-		aSumErr += abs(a[j] - aj);
-		bSumErr += abs(b[j] - bj);
-		cSumErr += abs(c[j] - cj);
-		// if (j == 417) printf("Index 417: c[j]: %f, cj: %f\n",c[j],cj);	// MCCALPIN
-	}
-	aAvgErr = aSumErr / (STREAM_TYPE) stream_array_size;
-	bAvgErr = bSumErr / (STREAM_TYPE) stream_array_size;
-	cAvgErr = cSumErr / (STREAM_TYPE) stream_array_size;
+	aSumErr = array_error_sum(a, aj, stream_array_size, &checked);
+	bSumErr = array_error_sum(b, bj, stream_array_size, &checked);
+	cSumErr = array_error_sum(c, cj, stream_array_size, &checked);
+	aAvgErr = aSumErr / (STREAM_TYPE) checked;
+	bAvgErr = bSumErr / (STREAM_TYPE) checked;
+	cAvgErr = cSumErr / (STREAM_TYPE) checked;
 
 	if (sizeof(STREAM_TYPE) == 4) {
 		epsilon = 1.e-6;
@@ -603,80 +6783,247 @@ void checkSTREAMresults (ssize_t stream_array_size)
 	else if (sizeof(STREAM_TYPE) == 8) {
 		epsilon = 1.e-13;
 	}
+	else if (sizeof(STREAM_TYPE) == 16) {	/* long double, __float128 */
+		epsilon = 1.e-15;
+	}
 	else {
 		printf("WEIRD: sizeof(STREAM_TYPE) = %lu\n",sizeof(STREAM_TYPE));
 		epsilon = 1.e-6;
 	}
 
 	err = 0;
-	if (abs(aAvgErr/aj) > epsilon) {
+	for (s=0; s<kernels_run; s++) {
+		/* the sums round once per element; allow for that */
+		double sumeps = epsilon * sqrt((double) stream_array_size);
+
+		if (kernel_ran[s] == 4 && fabs(read_sum - m.read_sum) > sumeps * m.read_sum) {
+			err++;
+			printf ("Failed Validation on Read sum: expected %e, observed %e\n", m.read_sum, read_sum);
+		}
+		if (kernel_ran[s] == 6 && fabs(mix_sum - m.mix_sum) > sumeps * m.mix_sum) {
+			err++;
+			printf ("Failed Validation on Mix sum: expected %e, observed %e\n", m.mix_sum, mix_sum);
+		}
+	}
+	if (avg_error_fails(aAvgErr, aj, epsilon)) {
 		err++;
 		printf ("Failed Validation on array a[], AvgRelAbsErr > epsilon (%e)\n",epsilon);
 		printf ("     Expected Value: %e, AvgAbsErr: %e, AvgRelAbsErr: %e\n",aj,aAvgErr,abs(aAvgErr)/aj);
-		ierr = 0;
-		for (j=0; j<stream_array_size; j++) {
-			if (abs(a[j]/aj-1.0) > epsilon) {
-				ierr++;
-#ifdef VERBOSE
-				if (ierr < 10) {
-					printf("         array a: index: %ld, expected: %e, observed: %e, relative error: %e\n",
-						j,aj,a[j],abs((aj-a[j])/aAvgErr));
-				}
-#endif
-			}
-		}
-		printf("     For array a[], %d errors were found.\n",ierr);
+		ierr = array_error_map("a", 0, a, aj, epsilon, stream_array_size);
+		printf("     For array a[], %ld errors were found.\n",(long) ierr);
 	}
-	if (abs(bAvgErr/bj) > epsilon) {
+	if (avg_error_fails(bAvgErr, bj, epsilon)) {
 		err++;
 		printf ("Failed Validation on array b[], AvgRelAbsErr > epsilon (%e)\n",epsilon);
 		printf ("     Expected Value: %e, AvgAbsErr: %e, AvgRelAbsErr: %e\n",bj,bAvgErr,abs(bAvgErr)/bj);
 		printf ("     AvgRelAbsErr > Epsilon (%e)\n",epsilon);
-		ierr = 0;
-		for (j=0; j<stream_array_size; j++) {
-			if (abs(b[j]/bj-1.0) > epsilon) {
-				ierr++;
-#ifdef VERBOSE
-				if (ierr < 10) {
-					printf("         array b: index: %ld, expected: %e, observed: %e, relative error: %e\n",
-						j,bj,b[j],abs((bj-b[j])/bAvgErr));
-				}
-#endif
-			}
-		}
-		printf("     For array b[], %d errors were found.\n",ierr);
+		ierr = array_error_map("b", 1, b, bj, epsilon, stream_array_size);
+		printf("     For array b[], %ld errors were found.\n",(long) ierr);
 	}
-	if (abs(cAvgErr/cj) > epsilon) {
+	if (avg_error_fails(cAvgErr, cj, epsilon)) {
 		err++;
 		printf ("Failed Validation on array c[], AvgRelAbsErr > epsilon (%e)\n",epsilon);
 		printf ("     Expected Value: %e, AvgAbsErr: %e, AvgRelAbsErr: %e\n",cj,cAvgErr,abs(cAvgErr)/cj);
 		printf ("     AvgRelAbsErr > Epsilon (%e)\n",epsilon);
-		ierr = 0;
-		for (j=0; j<stream_array_size; j++) {
-			if (abs(c[j]/cj-1.0) > epsilon) {
-				ierr++;
-#ifdef VERBOSE
-				if (ierr < 10) {
-					printf("         array c: index: %ld, expected: %e, observed: %e, relative error: %e\n",
-						j,cj,c[j],abs((cj-c[j])/cAvgErr));
-				}
-#endif
-			}
-		}
-		printf("     For array c[], %d errors were found.\n",ierr);
+		ierr = array_error_map("c", 2, c, cj, epsilon, stream_array_size);
+		printf("     For array c[], %ld errors were found.\n",(long) ierr);
 	}
 	if (err == 0) {
 		printf ("Solution Validates: avg error less than %e on all three arrays\n",epsilon);
 	}
+	if (checked < stream_array_size) {
+		/* no failures in k sampled lines: P(line bad) < 1 - (1 - C)^(1/k) at confidence C */
+		ssize_t line = MAX(64 / (ssize_t)sizeof(STREAM_TYPE), 1);
+		double k_lines = (double) checked / line, c_level = 0.95;
+
+		printf ("Sampled validation: %ld of %ld cache lines per array (%.3f%%)\n",
+		    (long) k_lines, (long)((stream_array_size + line - 1) / line),
+		    100.0 * checked / stream_array_size);
+		if (err == 0)
+			printf ("     with %.0f%% confidence fewer than %.4f%% of the lines are bad\n",
+			    100.0 * c_level, 100.0 * (1.0 - pow(1.0 - c_level, 1.0 / k_lines)));
+	}
 #ifdef VERBOSE
 	printf ("Results Validation Verbose Results: \n");
 	printf ("    Expected a(1), b(1), c(1): %f %f %f \n",aj,bj,cj);
 	printf ("    Observed a(1), b(1), c(1): %f %f %f \n",a[1],b[1],c[1]);
 	printf ("    Rel Errors on a, b, c:     %e %e %e \n",abs(aAvgErr/aj),abs(bAvgErr/bj),abs(cAvgErr/cj));
 #endif
+	return err;
 }
 
 #ifdef TUNED
+#if defined(__riscv_v_intrinsic) && !defined(NO_RVV)
+/*
+ * RISC-V Vector versions of the tuned kernels.  Each thread takes one
+ * contiguous block and strip-mines it with vsetvl/vle64/vse64; the LMUL
+ * (register group size, i.e. how many vector registers feed each load
+ * or store) is picked at runtime with --lmul, since the best depth of
+ * outstanding requests differs between local and interconnect memory.
+ * Build with "make stream_rvv.exe".  The scalar loops below are used if
+ * AT_HWCAP reports no V, but the binary as a whole is built for a V
+ * -march and the compiler and libc may use V elsewhere, so it is meant
+ * for V-capable cores only.
+ */
+#include <riscv_vector.h>
+#include <sys/auxv.h>
+
+_Static_assert(sizeof(STREAM_TYPE) == sizeof(double), "RVV kernels need STREAM_TYPE=double");
+
+#define RVV_KERNELS(LMUL) \
+static void rvv_copy_m##LMUL(double *dst, const double *src, size_t n) \
+{ \
+	size_t vl; \
+	for (; n > 0; n -= vl, src += vl, dst += vl) { \
+		vl = __riscv_vsetvl_e64m##LMUL(n); \
+		__riscv_vse64_v_f64m##LMUL(dst, __riscv_vle64_v_f64m##LMUL(src, vl), vl); \
+	} \
+} \
+static void rvv_scale_m##LMUL(double *dst, const double *src, double scalar, size_t n) \
+{ \
+	size_t vl; \
+	for (; n > 0; n -= vl, src += vl, dst += vl) { \
+		vl = __riscv_vsetvl_e64m##LMUL(n); \
+		__riscv_vse64_v_f64m##LMUL(dst, __riscv_vfmul_vf_f64m##LMUL( \
+		    __riscv_vle64_v_f64m##LMUL(src, vl), scalar, vl), vl); \
+	} \
+} \
+static void rvv_add_m##LMUL(double *dst, const double *x, const double *y, size_t n) \
+{ \
+	size_t vl; \
+	for (; n > 0; n -= vl, x += vl, y += vl, dst += vl) { \
+		vl = __riscv_vsetvl_e64m##LMUL(n); \
+		__riscv_vse64_v_f64m##LMUL(dst, __riscv_vfadd_vv_f64m##LMUL( \
+		    __riscv_vle64_v_f64m##LMUL(x, vl), __riscv_vle64_v_f64m##LMUL(y, vl), vl), vl); \
+	} \
+} \
+static void rvv_triad_m##LMUL(double *dst, const double *x, const double *y, double scalar, size_t n) \
+{ \
+	size_t vl; \
+	for (; n > 0; n -= vl, x += vl, y += vl, dst += vl) { \
+		vl = __riscv_vsetvl_e64m##LMUL(n); \
+		__riscv_vse64_v_f64m##LMUL(dst, __riscv_vfmacc_vf_f64m##LMUL( \
+		    __riscv_vle64_v_f64m##LMUL(x, vl), scalar, __riscv_vle64_v_f64m##LMUL(y, vl), vl), vl); \
+	} \
+}
+
+RVV_KERNELS(1)
+RVV_KERNELS(2)
+RVV_KERNELS(4)
+RVV_KERNELS(8)
+
+static const struct {
+	int	lmul;
+	void	(*copy)(double *, const double *, size_t);
+	void	(*scale)(double *, const double *, double, size_t);
+	void	(*add)(double *, const double *, const double *, size_t);
+	void	(*triad)(double *, const double *, const double *, double, size_t);
+} rvv_ops[] = {
+	{1, rvv_copy_m1, rvv_scale_m1, rvv_add_m1, rvv_triad_m1},
+	{2, rvv_copy_m2, rvv_scale_m2, rvv_add_m2, rvv_triad_m2},
+	{4, rvv_copy_m4, rvv_scale_m4, rvv_add_m4, rvv_triad_m4},
+	{8, rvv_copy_m8, rvv_scale_m8, rvv_add_m8, rvv_triad_m8},
+};
+static int	rvv_sel = -1;	/* index into rvv_ops[], -1 = scalar */
+
+/* lmul is 1, 2, 4 or 8; returns -1 for an invalid LMUL */
+int tuned_init(int lmul)
+{
+	int i;
+
+	rvv_sel = -1;
+	for (i = 0; i < 4; i++)
+		if (rvv_ops[i].lmul == lmul)
+			break;
+	if (i == 4)
+		return -1;
+	if (getauxval(AT_HWCAP) & (1UL << ('V' - 'A')))
+		rvv_sel = i;
+	return 0;
+}
+
+void tuned_describe(void)
+{
+	if (rvv_sel >= 0)
+		printf("Tuned kernels: RVV, LMUL=%d, VLEN=%d bits\n",
+		    rvv_ops[rvv_sel].lmul, (int)(8 * __riscv_vsetvlmax_e8m1()));
+	else
+		printf("Tuned kernels: scalar (V extension not available)\n");
+}
+
+#define RVV_RUN(call) do { \
+	_Pragma("omp parallel") \
+	{ \
+		ssize_t lo, hi; \
+		thread_range(stream_array_size, &lo, &hi); \
+		if (hi > lo) \
+			call; \
+	} \
+	} while (0)
+
+void tuned_STREAM_Copy(ssize_t stream_array_size)
+{
+	ssize_t j;
+
+	if (rvv_sel >= 0) {
+		RVV_RUN(rvv_ops[rvv_sel].copy(c + lo, a + lo, hi - lo));
+		return;
+	}
+#pragma omp parallel for
+        for (j=0; j<stream_array_size; j++)
+            c[j] = a[j];
+}
+
+void tuned_STREAM_Scale(STREAM_TYPE scalar, ssize_t stream_array_size)
+{
+	ssize_t j;
+
+	if (rvv_sel >= 0) {
+		RVV_RUN(rvv_ops[rvv_sel].scale(b + lo, c + lo, scalar, hi - lo));
+		return;
+	}
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++)
+	    b[j] = scalar*c[j];
+}
+
+void tuned_STREAM_Add(ssize_t stream_array_size)
+{
+	ssize_t j;
+
+	if (rvv_sel >= 0) {
+		RVV_RUN(rvv_ops[rvv_sel].add(c + lo, a + lo, b + lo, hi - lo));
+		return;
+	}
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++)
+	    c[j] = a[j]+b[j];
+}
+
+void tuned_STREAM_Triad(STREAM_TYPE scalar, ssize_t stream_array_size)
+{
+	ssize_t j;
+
+	if (rvv_sel >= 0) {
+		RVV_RUN(rvv_ops[rvv_sel].triad(a + lo, b + lo, c + lo, scalar, hi - lo));
+		return;
+	}
+#pragma omp parallel for
+	for (j=0; j<stream_array_size; j++)
+	    a[j] = b[j]+scalar*c[j];
+}
+#else
+/* no LMUL to choose, but keep --lmul to the values the RVV build accepts */
+int tuned_init(int lmul)
+{
+	return (lmul == 1 || lmul == 2 || lmul == 4 || lmul == 8) ? 0 : -1;
+}
+
+void tuned_describe(void)
+{
+	printf("Tuned kernels: scalar\n");
+}
+
 /* stubs for "tuned" versions of the kernels */
 void tuned_STREAM_Copy(ssize_t stream_array_size)
 {
@@ -711,3 +7058,4 @@ void tuned_STREAM_Triad(STREAM_TYPE scalar, ssize_t stream_array_size)
 }
 /* end of stubs for the "tuned" versions of the kernels */
 #endif
+#endif